@@ -0,0 +1,332 @@
+#include "analysis.h"
+
+#include<gsl/gsl_rstat.h>
+
+template <typename T>
+void sweep(const BasicArray2d<T> &a, const AccumulatorList<T> &accs) {
+    if(accs.empty()) return;
+
+    int nx = a.rows(), ny = a.cols();
+    for(int i = 0; i < nx; i ++ )
+        for(const unique_ptr<Accumulator<T>> &acc : accs)
+            acc->add_row(i, a[i], ny);
+
+    for(const unique_ptr<Accumulator<T>> &acc : accs)
+        acc->finish();
+}
+
+
+/** The limits of the part of an array where abs is above the sensitivities,
+ * as found by find_interesting, but in one pass: the maxima of each row and
+ * column are recorded, and the limits follow from those and the overall max.
+ * Like find_interesting, they're kept as squared magnitudes, to save the sqrt.
+ *
+ * If half, the rows are the ny/2 + 1 non-redundant columns of the spectrum of a
+ * real array, and the limits are for the full spectrum, whose other columns are
+ * the mirror images of columns [1, (ny+1)/2). If shifted, the limits are for the
+ * array after an fftshift.
+ */
+template <typename T>
+class LimitsAccumulator : public Accumulator<T> {
+private:
+    Limits &res;
+    double abs_sens, rel_sens;
+    int nx, ny;
+    bool half, shifted;
+    vector<double> row_max, mirror_row_max, col_max;
+
+    MagnitudeKey<Abs> key;
+
+    /** max key over [begin, end) of row, also updating the column maxima */
+    double scan(const T * row, int begin, int end) {
+        double m = 0.0;
+        double * cols = col_max.data();
+        for(int j = begin; j < end; j ++ ) {
+            double key_here = key(row[j]);
+            cols[j] = max(cols[j], key_here);
+            m = max(m, key_here);
+        }
+        return m;
+    }
+
+public:
+    LimitsAccumulator(Limits &res, double abs_sens, double rel_sens, int nx, int ny, bool half, bool shifted) :
+        res(res), abs_sens(abs_sens), rel_sens(rel_sens), nx(nx), ny(ny), half(half), shifted(shifted),
+        row_max(nx, 0.0), mirror_row_max(nx, 0.0), col_max(ny, 0.0) {
+        // same conventions as find_interesting
+        if(abs_sens == 0.0) this->abs_sens = INFINITY;
+        if(rel_sens == 0.0) this->rel_sens = 2.0;
+    }
+
+    void add_row(int i, const T * row, int n) {
+        if(!half) {
+            row_max[i] = scan(row, 0, n);
+            return;
+        }
+        int mirror_end = (ny + 1) / 2;
+        double m = scan(row, 0, 1);
+        mirror_row_max[i] = scan(row, 1, mirror_end);
+        row_max[i] = max(max(m, mirror_row_max[i]), scan(row, mirror_end, n));
+    }
+
+    void finish() {
+        if(half) {
+            // row i of the full spectrum also holds the mirror image of row -i
+            vector<double> full_row_max(nx);
+            for(int i = 0; i < nx; i ++ )
+                full_row_max[i] = max(row_max[i], mirror_row_max[(nx - i) % nx]);
+            row_max = full_row_max;
+            for(int j = ny/2 + 1; j < ny; j ++ )
+                col_max[j] = col_max[ny - j];
+        }
+        if(shifted) {
+            row_max = fftshift(row_max);
+            col_max = fftshift(col_max);
+        }
+
+        double key_max = *max_element(row_max.begin(), row_max.end());
+        double rel_key = key.to_key(rel_sens * key.from_key(key_max));
+        double abs_key = key.to_key(abs_sens);
+        auto above = [&](double m) { return m > rel_key || m > abs_key; };
+
+        int imin = nx, imax = 0, jmin = ny, jmax = 0;
+        for(int i = 0; i < nx; i ++ )
+            if(above(row_max[i])) {
+                imin = min(imin, i);
+                imax = i;
+            }
+        for(int j = 0; j < ny; j ++ )
+            if(above(col_max[j])) {
+                jmin = min(jmin, j);
+                jmax = j;
+            }
+        // increase maxima by one to follow inclusive-exclusive convention
+        res = Limits{imin, imax + 1, jmin, jmax + 1};
+    }
+};
+
+
+/** How a walk along a row or column finds its point: one of the grid_ or interpolate_ functions */
+using Locator = ValueError<double> (*)(const vector<double> &, const vector<double> &);
+
+/** find_min and fwhp: abs along the first row */
+template <typename T>
+class RowWalkAccumulator : public Accumulator<T> {
+private:
+    ValueError<double> &res;
+    const vector<double> &coord;
+    Locator locate;
+    vector<double> vals;
+
+public:
+    RowWalkAccumulator(ValueError<double> &res, const vector<double> &coord, Locator locate) :
+        res(res), coord(coord), locate(locate) {}
+
+    void add_row(int i, const T * row, int n) {
+        if(i != 0) return;
+        // row may be only half, if it came from a real-to-complex transform
+        n = min(n, (int)coord.size());
+        for(int j = 0; j < n; j ++ )
+            vals.push_back(abs(row[j]));
+    }
+
+    void finish() {
+        res = locate(vals, coord);
+    }
+};
+
+
+/** fwhp_y: abs along the first column */
+template <typename T>
+class ColumnWalkAccumulator : public Accumulator<T> {
+private:
+    ValueError<double> &res;
+    const vector<double> &coord;
+    Locator locate;
+    vector<double> vals;
+
+public:
+    ColumnWalkAccumulator(ValueError<double> &res, const vector<double> &coord, Locator locate) :
+        res(res), coord(coord), locate(locate) {}
+
+    void add_row(int i, const T * row, int n) {
+        if(i < (int)coord.size()) vals.push_back(abs(row[0]));
+    }
+
+    void finish() {
+        res = locate(vals, coord);
+    }
+};
+
+
+/** central_amplitude: abs of the zero-frequency element */
+template <typename T>
+class CentralAccumulator : public Accumulator<T> {
+private:
+    double &res;
+
+public:
+    CentralAccumulator(double &res) : res(res) {}
+
+    void add_row(int i, const T * row, int n) {
+        if(i == 0) res = abs(row[0]);
+    }
+    void finish() {}
+};
+
+
+/** in_phase_stat: mean and standard deviation of the phase within radius */
+template <typename T>
+class PhaseStatAccumulator : public Accumulator<T> {
+private:
+    ValueError<double> &res;
+    const vector<double> &xs, &ys;
+    double radius;
+    gsl_rstat_workspace * rstat;
+
+public:
+    PhaseStatAccumulator(ValueError<double> &res, const vector<double> &xs, const vector<double> &ys, double radius) :
+        res(res), xs(xs), ys(ys), radius(radius), rstat(gsl_rstat_alloc()) {}
+    ~PhaseStatAccumulator() { gsl_rstat_free(rstat); }
+
+    void add_row(int i, const T * row, int n) {
+        for(int j = 0; j < n; j ++ ) {
+            double rsq = xs[j] * xs[j] + ys[i] * ys[i];
+            if(rsq < radius * radius)
+                gsl_rstat_add(myarg(row[j]), rstat);
+        }
+    }
+
+    void finish() {
+        res.err = gsl_rstat_sd(rstat);
+        res.val = gsl_rstat_mean(rstat);
+    }
+};
+
+
+AnalysisEngine::AnalysisEngine(const vector<string> &tasks, double abs_sens, double rel_sens, bool interpolate) :
+    interpolate(interpolate), abs_sens(abs_sens), rel_sens(rel_sens) {
+    find_min = contains(tasks, "find_min");
+    fwhp = contains(tasks, "fwhp");
+    fwhp_y = contains(tasks, "fwhp_y");
+    central_amplitude = contains(tasks, "central_amplitude");
+    in_phase_stat = contains(tasks, "in_phase_stat");
+    in_lims = any_begins_with(tasks, "print_in");
+    out_lims = any_begins_with(tasks, "print_out") || contains(tasks, "out_lims");
+}
+
+AnalysisEngine::AnalysisEngine(const Config &conf) : AnalysisEngine(conf.tasks, conf.abs_sens, conf.rel_sens, conf.estimate != "grid") {}
+
+template <typename T>
+void AnalysisEngine::analyse_in(const BasicArray2d<T> &in, const vector<double> &xs, const vector<double> &ys, double radius, ShapeResults &res) const {
+    AccumulatorList<T> accs;
+    if(in_phase_stat)
+        accs.emplace_back(new PhaseStatAccumulator<T>(res.in_phase, xs, ys, radius));
+    if(in_lims)
+        accs.emplace_back(new LimitsAccumulator<T>(res.in_lims, abs_sens, rel_sens, in.rows(), in.cols(), false, false));
+
+    sweep(in, accs);
+}
+
+template <typename T>
+void AnalysisEngine::analyse_out(const BasicArray2d<T> &out, int n_cols, const vector<double> &ps, const vector<double> &qs, ShapeResults &res) const {
+    bool half = (out.cols() != n_cols);
+
+    Locator first_min = interpolate ? interpolate_first_min : grid_first_min;
+    Locator half_power = interpolate ? interpolate_half_power : grid_half_power;
+
+    AccumulatorList<T> accs;
+    if(find_min)
+        accs.emplace_back(new RowWalkAccumulator<T>(res.first_min, ps, first_min));
+    if(fwhp)
+        accs.emplace_back(new RowWalkAccumulator<T>(res.fwhp, ps, half_power));
+    if(fwhp_y)
+        accs.emplace_back(new ColumnWalkAccumulator<T>(res.fwhp_y, qs, half_power));
+    if(central_amplitude)
+        accs.emplace_back(new CentralAccumulator<T>(res.central_amplitude));
+    if(out_lims)
+        accs.emplace_back(new LimitsAccumulator<T>(res.out_lims, abs_sens, rel_sens, out.rows(), n_cols, half, true));
+
+    sweep(out, accs);
+}
+
+bool AnalysisEngine::radial_only() const {
+    return !in_phase_stat && !in_lims && !out_lims;
+}
+
+// how many frequencies radial_walk works out the image at to start with
+#define RADIAL_FIRST_BLOCK 64
+
+/** abs of the image of a radial aperture along coord, from the zero frequency up to a few
+ * points past where first_min_index and half_power_index stop, which is as far as the
+ * locators look. It's worked out in blocks of twice the length until then, but not past
+ * the highest positive frequency, after which coord wraps to the negative ones.
+ */
+vector<double> radial_walk(const RadialGenerator &gen, const vector<double> &params, double scale, const vector<double> &coord) {
+    int n_pos = 1;
+    while(n_pos < (int)coord.size() && coord[n_pos] > coord[n_pos - 1])
+        n_pos ++;
+
+    vector<double> image, vals;
+    int n = min(RADIAL_FIRST_BLOCK, n_pos);
+    while(true) {
+        radial_image(gen, params, coord, image.size(), n, scale, image);
+        vals.resize(n);
+        for(int j = 0; j < n; j ++ )
+            vals[j] = abs(image[j]);
+
+        // the cubic around the minimum needs two more points, the parabola at half power one
+        bool done = (first_min_index(vals) + 2 < n) && (half_power_index(vals) + 1 < n);
+        if(done || n == n_pos) return vals;
+        n = min(2 * n, n_pos);
+    }
+}
+
+void AnalysisEngine::analyse_radial(const RadialGenerator &gen, const vector<double> &params, double scale, const vector<double> &ps, const vector<double> &qs, ShapeResults &res) const {
+    Locator first_min = interpolate ? interpolate_first_min : grid_first_min;
+    Locator half_power = interpolate ? interpolate_half_power : grid_half_power;
+
+    vector<double> vals;
+    if(find_min || fwhp || central_amplitude)
+        vals = radial_walk(gen, params, scale, ps);
+    if(find_min)
+        res.first_min = first_min(vals, ps);
+    if(fwhp)
+        res.fwhp = half_power(vals, ps);
+    if(central_amplitude)
+        res.central_amplitude = vals[0];
+    if(fwhp_y) {
+        // the same image along the other axis, unless the frequencies differ
+        if(vals.empty() || qs != ps)
+            vals = radial_walk(gen, params, scale, qs);
+        res.fwhp_y = half_power(vals, qs);
+    }
+}
+
+bool analytic_results(const ShapeProperties &sp, ShapeResults &res) {
+    // the first zero and half power point of 2 J1(x) / x, and the half power point of sin(x) / x
+    const double airy_zero = 3.8317059702, airy_half_power = 1.6163399479, sinc_half_power = 1.3915573507;
+
+    if(sp.generator_key == "circular") {
+        double radius = sp.shape_params[0];
+        res.first_min = ValueError<double>{airy_zero / radius, 0.0};
+        res.fwhp = res.fwhp_y = ValueError<double>{airy_half_power / radius, 0.0};
+        return true;
+    }
+    if(sp.generator_key == "rectangle") {
+        // the full widths, and the image is sin(p w/2) / (p w/2) along each axis
+        double wx = sp.shape_params[0], wy = sp.shape_params[1];
+        res.first_min = ValueError<double>{2 * M_PI / wx, 0.0};
+        res.fwhp = ValueError<double>{2 * sinc_half_power / wx, 0.0};
+        res.fwhp_y = ValueError<double>{2 * sinc_half_power / wy, 0.0};
+        return true;
+    }
+    return false;
+}
+
+template void AnalysisEngine::analyse_in(const BasicArray2d<complex<double>> &in, const vector<double> &xs, const vector<double> &ys, double radius, ShapeResults &res) const;
+template void AnalysisEngine::analyse_in(const BasicArray2d<double> &in, const vector<double> &xs, const vector<double> &ys, double radius, ShapeResults &res) const;
+template void AnalysisEngine::analyse_in(const BasicArray2d<complex<float>> &in, const vector<double> &xs, const vector<double> &ys, double radius, ShapeResults &res) const;
+template void AnalysisEngine::analyse_in(const BasicArray2d<float> &in, const vector<double> &xs, const vector<double> &ys, double radius, ShapeResults &res) const;
+template void AnalysisEngine::analyse_out(const BasicArray2d<complex<double>> &out, int n_cols, const vector<double> &ps, const vector<double> &qs, ShapeResults &res) const;
+template void AnalysisEngine::analyse_out(const BasicArray2d<complex<float>> &out, int n_cols, const vector<double> &ps, const vector<double> &qs, ShapeResults &res) const;
@@ -0,0 +1,96 @@
+#ifndef MYANALYSIS
+#define MYANALYSIS
+
+#include<vector>
+#include<memory>
+
+#include "array2d.h"
+#include "util.h"
+
+using namespace std;
+
+/** Everything the data tasks find out about one shape.
+ * Only the fields of the tasks that were asked for are filled in.
+ */
+struct ShapeResults {
+    ValueError<double> first_min, fwhp, fwhp_y, in_phase;
+    double central_amplitude;
+    Limits in_lims, out_lims;
+};
+
+/** The part of a task that looks at an array. Instead of walking the array
+ * itself, it is handed every row in order during a sweep, and works out its
+ * result from them when the sweep is done.
+ */
+template <typename T>
+class Accumulator {
+public:
+    virtual ~Accumulator() {}
+    /** row number i of the array, which has n elements */
+    virtual void add_row(int i, const T * row, int n) = 0;
+    /** called once after the last row */
+    virtual void finish() = 0;
+};
+
+template <typename T>
+using AccumulatorList = vector<unique_ptr<Accumulator<T>>>;
+
+/** Walk a once, handing each row to all the accumulators, then finish them */
+template <typename T>
+void sweep(const BasicArray2d<T> &a, const AccumulatorList<T> &accs);
+
+/**
+ * The data tasks of a config, compiled into (at most) one sweep over the aperture
+ * and one over its transform, whatever the number of tasks. Make one per worker,
+ * and run it on every shape.
+ */
+class AnalysisEngine {
+private:
+    bool find_min, fwhp, fwhp_y, central_amplitude, in_phase_stat;
+    // find the minimum and half power points in between the grid points
+    bool interpolate;
+    bool in_lims, out_lims;
+    double abs_sens, rel_sens;
+
+public:
+    AnalysisEngine(const vector<string> &tasks, double abs_sens, double rel_sens, bool interpolate = false);
+    AnalysisEngine(const Config &conf);
+
+    /**
+     * Do the tasks on the aperture in: in_phase_stat, within radius, and the
+     * limits for printing it.
+     */
+    template <typename T>
+    void analyse_in(const BasicArray2d<T> &in, const vector<double> &xs, const vector<double> &ys, double radius, ShapeResults &res) const;
+
+    /**
+     * Do the tasks on the transform out: find_min, fwhp, fwhp_y, central_amplitude
+     * and the limits for printing it. The limits are for the fftshift-ed image, but
+     * out is NOT shifted. If out has ny/2 + 1 columns, it's the half spectrum of a
+     * real aperture with n_cols columns, and the limits are worked out for the whole
+     * spectrum. ps and qs are the (unshifted) frequencies along the rows and columns.
+     */
+    template <typename T>
+    void analyse_out(const BasicArray2d<T> &out, int n_cols, const vector<double> &ps, const vector<double> &qs, ShapeResults &res) const;
+
+    /** True if all the tasks only need the image along the axes, which for a radially
+     * symmetric aperture is analyse_radial. The limits and in_phase_stat need the arrays.
+     */
+    bool radial_only() const;
+
+    /**
+     * Do the same tasks as analyse_out, for the radially symmetric aperture gen with params,
+     * but from its Hankel transform, without any arrays. The image is only worked out along
+     * ps (and qs for fwhp_y) as far out as the tasks look. scale is as in radial_image.
+     */
+    void analyse_radial(const RadialGenerator &gen, const vector<double> &params, double scale, const vector<double> &ps, const vector<double> &qs, ShapeResults &res) const;
+};
+
+/**
+ * The exact find_min, fwhp and fwhp_y results (half widths, with no error) for the
+ * apertures whose image is known: circular, an Airy pattern, and rectangle, a sinc
+ * along each axis. Returns false for the other apertures.
+ */
+bool analytic_results(const ShapeProperties &sp, ShapeResults &res);
+
+#endif
@@ -1,6 +1,12 @@
 #include "array2d.h"
 
 #include<gsl/gsl_rstat.h>
+#include<cstdint>
+#include<stdexcept>
+
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<unistd.h>
 
 #define DEBUG_OUT false
 Logger arr2dlog(stdout, "arr2d", DEBUG_OUT);
@@ -11,31 +17,63 @@ string lims_to_str(const Limits &l) {
     return string(buff);
 }
 
-Array2d::Array2d(int size_x, int size_y) : nx(size_x), ny(size_y) {
+template <typename T>
+BasicArray2d<T>::BasicArray2d(int size_x, int size_y) : nx(size_x), ny(size_y), mapped_bytes(0) {
     // log
     char msg[64];
     sprintf(msg, "constructed array %d x %d", nx, ny);
     arr2dlog(msg);
 
     // allocate memory
-    arr = (complex<double>*) fftw_alloc_complex(nx * ny);
+    arr = (T*) fftw_malloc(sizeof(T) * nx * ny);
+}
+
+/** Construct an array mapped from a new file in scratch_dir. The file is deleted
+ * straight away, so it only takes up disk space until the array is destructed,
+ * even if the program doesn't end well. The mapping starts on a page boundary,
+ * which is as aligned as fftw_malloc.
+ */
+template <typename T>
+BasicArray2d<T>::BasicArray2d(int size_x, int size_y, const string &scratch_dir) : nx(size_x), ny(size_y) {
+    char msg[64];
+    sprintf(msg, "constructed mapped array %d x %d", nx, ny);
+    arr2dlog(msg);
+
+    mapped_bytes = sizeof(T) * (size_t)nx * ny;
+    string filename = scratch_dir + "/array_XXXXXX";
+    int fd = mkstemp(&filename[0]);
+    if(fd < 0) throw runtime_error("Could not create a scratch file in " + scratch_dir);
+    unlink(filename.c_str());
+
+    if(ftruncate(fd, mapped_bytes) != 0) {
+        close(fd);
+        throw runtime_error("Could not make a scratch file of " + to_string(mapped_bytes) + " bytes in " + scratch_dir);
+    }
+    void * mapped = mmap(NULL, mapped_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // the mapping keeps the file open
+    close(fd);
+    if(mapped == MAP_FAILED) throw runtime_error("Could not map a scratch file in " + scratch_dir);
+    arr = (T*) mapped;
 }
 
-Array2d::~Array2d() {
+template <typename T>
+BasicArray2d<T>::~BasicArray2d() {
     // log
     char msg[64];
     sprintf(msg, "destructed array %d x %d", nx, ny);
     arr2dlog(msg);
 
     // free memory
-    fftw_free(ptr());
+    if(mapped_bytes > 0) munmap(arr, mapped_bytes);
+    else fftw_free(ptr());
 }
 
 /** Return the value of element [ix][iy] through round bracket operator
  * Use like a(ix, iy). Return is immutable, good for use with const Array2d &.
  */
-complex<double> Array2d::operator()(int ix, int iy) const {
-    int idx = ny*ix + iy;
+template <typename T>
+T BasicArray2d<T>::operator()(int ix, int iy) const {
+    size_t idx = (size_t)ny*ix + iy;
     return arr[idx];
 }
 
@@ -43,15 +81,40 @@ complex<double> Array2d::operator()(int ix, int iy) const {
  * Use like a[ix][iy] for value of element, like a normal 2d array.
  * Return is mutable.
  */
-complex<double> * Array2d::operator[](int ix) {
-    return (arr + (ny*ix));
+template <typename T>
+T * BasicArray2d<T>::operator[](int ix) {
+    return (arr + ((size_t)ny*ix));
+}
+
+template <typename T>
+const T * BasicArray2d<T>::operator[](int ix) const {
+    return (arr + ((size_t)ny*ix));
+}
+
+/** Number of rows, nx */
+template <typename T>
+int BasicArray2d<T>::rows() const {
+    return nx;
+}
+
+/** Number of columns, ny */
+template <typename T>
+int BasicArray2d<T>::cols() const {
+    return ny;
+}
+
+/** True if the array is mapped from a file rather than kept in memory */
+template <typename T>
+bool BasicArray2d<T>::is_mapped() const {
+    return mapped_bytes > 0;
 }
 
 /** Multiply the first array with the second element-wise,
  * storing results in the first.
  * Returns 0 if succesful or something else if failed.
  */
-int Array2d::mult(const Array2d& a) {
+template <typename T>
+int BasicArray2d<T>::mult(const BasicArray2d& a) {
     if(nx != a.nx) return -1;
     if(ny != a.ny) return -1;
 
@@ -62,7 +125,8 @@ int Array2d::mult(const Array2d& a) {
 }
 
 /** Multiply every element in the array by a scalar c */
-int Array2d::mult_each(complex<double> c) {
+template <typename T>
+int BasicArray2d<T>::mult_each(T c) {
     for(int i = 0; i < nx; i ++ )
         for(int j = 0; j < ny; j ++ )
             (*this)[i][j] *= c;
@@ -70,12 +134,14 @@ int Array2d::mult_each(complex<double> c) {
 }
 
 /** Divide every element in the array by a scalar c */
-int Array2d::divide_each(complex<double> c) {
-    return this->mult_each(1.0 / c);
+template <typename T>
+int BasicArray2d<T>::divide_each(T c) {
+    return this->mult_each((T)1.0 / c);
 }
 
 /** Test for near equality to within EPS */
-bool operator==(const Array2d &a, const Array2d &b) {
+template <typename T>
+bool operator==(const BasicArray2d<T> &a, const BasicArray2d<T> &b) {
     if(a.nx != b.nx) return false;
     if(a.ny != b.ny) return false;
     
@@ -89,11 +155,12 @@ bool operator==(const Array2d &a, const Array2d &b) {
     return true;
 }
 
-/** Cast the pointer to fftw_complex*,
+/** Cast the pointer to fftw_complex* (or double* for real arrays),
  * such that it can be used with fftw library
  */
-fftw_complex * Array2d::ptr() {
-    return (fftw_complex*) arr;
+template <typename T>
+typename fftw_type<T>::type * BasicArray2d<T>::ptr() {
+    return (typename fftw_type<T>::type *) arr;
 }
 
 
@@ -103,29 +170,34 @@ fftw_complex * Array2d::ptr() {
  * 
  *  To ignore one of absolute or relative sensitivities, set them to 0.
  */
-Limits Array2d::find_interesting(complex_to_real fun, double abs_sens, double rel_sens) const {
+template <typename T> template <typename P>
+Limits BasicArray2d<T>::find_interesting(P fun, double abs_sens, double rel_sens) const {
     // check if caller wants to ignore one criterion
     if(abs_sens == 0.0) abs_sens = INFINITY; // nothing is greater than inf
     if(rel_sens == 0.0) rel_sens = 2.0;      // nothing is greater than 2*max
 
+    // compare keys rather than abs(fun), which saves the sqrt for fun = myabs
+    // (and can only differ from abs within a rounding error of the thresholds)
+    MagnitudeKey<P> key{fun};
     int imin = nx, imax = 0, jmin = ny, jmax = 0;
-    double fun_max = 0.0, abs_here;
+    double key_max = 0.0;
 
     // walk the array once and find max abs value of fun
     for(int i = 0; i < nx; i ++ ) {
-        for(int j = 0; j < ny; j ++ ) {
-            abs_here = abs(fun((*this)(i, j)));
-            if(abs_here > fun_max)
-                fun_max = abs_here;
-        }
+        const T * row = (*this)[i];
+        for(int j = 0; j < ny; j ++ )
+            key_max = max(key_max, key(row[j]));
     }
 
     // walk again and record where abs value of fun
     // is greater than fraction of maximum found earlier
+    double rel_key = key.to_key(rel_sens * key.from_key(key_max));
+    double abs_key = key.to_key(abs_sens);
     for(int i = 0; i < nx; i ++ ) {
+        const T * row = (*this)[i];
         for(int j = 0; j < ny; j ++ ) {
-            abs_here = abs(fun((*this)(i, j)));
-            if(abs_here > rel_sens * fun_max || abs_here > abs_sens) {
+            double key_here = key(row[j]);
+            if(key_here > rel_key || key_here > abs_key) {
                 if(i > imax) imax = i;
                 if(i < imin) imin = i;
                 if(j > jmax) jmax = j;
@@ -147,7 +219,8 @@ Limits Array2d::find_interesting(complex_to_real fun, double abs_sens, double re
 
 /** Print function fun applied to all the elements, formatted as 2d array
  */
-void Array2d::print_prop(complex_to_real fun, FILE * out_file) const {
+template <typename T> template <typename P>
+void BasicArray2d<T>::print_prop(P fun, FILE * out_file) const {
     for(int ix = 0; ix < nx; ix++) {
         for(int iy = 0; iy < ny; iy++)
             fprintf(out_file, PRINT_FORMAT, fun((*this)(ix, iy)));
@@ -157,7 +230,8 @@ void Array2d::print_prop(complex_to_real fun, FILE * out_file) const {
 
 
 /* Print function applied to all elements within limits specified in lim */
-void Array2d::print_prop(complex_to_real fun, const Limits &lim, FILE * out_file) const {
+template <typename T> template <typename P>
+void BasicArray2d<T>::print_prop(P fun, const Limits &lim, FILE * out_file) const {
     int imin = lim[0], imax = lim[1], jmin = lim[2], jmax = lim[3];
 
     for(int i = imin; i < imax; i++) {
@@ -170,7 +244,8 @@ void Array2d::print_prop(complex_to_real fun, const Limits &lim, FILE * out_file
 /** Make a deep copy of this into another array, which must have the same size.
  * returns non-zero if copy failed.
  */
-int Array2d::copy_into(Array2d &a) const {
+template <typename T>
+int BasicArray2d<T>::copy_into(BasicArray2d &a) const {
     arr2dlog("copy_into called");
     if(a.nx != (*this).nx || a.ny != (*this).ny) return 1;
 
@@ -183,41 +258,188 @@ int Array2d::copy_into(Array2d &a) const {
 
 /** 
  * The zero-frequency component is shifted to the middle, IN PLACE!!!
- * The function allocates another array of the same size as a, so be careful
- * to not run out of memory.
+ * No second array is allocated: each row is rotated by half its length, and the
+ * rows are swapped with the ones half the array away. The two rows being
+ * worked on stay in cache between both steps, so the array is only streamed once.
+ * For an odd number of rows the row order is rotated by three reversals instead.
  **/
-void fftshift(Array2d &a) {
+template <typename T>
+void fftshift(BasicArray2d<T> &a) {
     arr2dlog("fftshift(Array2d) call");
-    Array2d b(a.nx, a.ny);
-
-    int shift_x = (a.ny+1) / 2;
-    int shift_y = (a.nx+1) / 2;
-    for(int i = 0; i < a.nx; i ++ )
-        for(int j = 0; j < a.ny; j ++ ) {
-            int source_i = (i + shift_y) % a.nx;
-            int source_j = (j + shift_x) % a.ny;
-            b[i][j] = a(source_i, source_j);
+    int nx = a.nx, ny = a.ny;
+    int shift_x = (ny+1) / 2;
+    int shift_y = (nx+1) / 2;
+
+    auto shift_row = [&](T * row) {
+        if(ny % 2 == 0) swap_ranges(row, row + shift_x, row + shift_x);
+        else rotate(row, row + shift_x, row + ny);
+    };
+    auto reverse_rows = [&](int first, int last) {
+        for(last --; first < last; first ++, last -- )
+            swap_ranges(a[first], a[first] + ny, a[last]);
+    };
+
+    if(nx % 2 == 0) {
+        for(int i = 0; i < shift_y; i ++ ) {
+            shift_row(a[i]);
+            shift_row(a[i + shift_y]);
+            swap_ranges(a[i], a[i] + ny, a[i + shift_y]);
+        }
+    }
+    else {
+        for(int i = 0; i < nx; i ++ )
+            shift_row(a[i]);
+        reverse_rows(0, shift_y);
+        reverse_rows(shift_y, nx);
+        reverse_rows(0, nx);
+    }
+}
+
+template <typename T>
+void checkerboard(BasicArray2d<T> &a) {
+    int nx = a.rows(), ny = a.cols();
+    for(int i = 0; i < nx; i ++ ) {
+        T * row = a[i];
+        for(int j = (i + 1) % 2; j < ny; j += 2)
+            row[j] = -row[j];
+    }
+}
+
+template <typename T>
+int expand_hermitian(const BasicArray2d<T> &half, BasicArray2d<T> &full) {
+    int nx = full.rows(), ny = full.cols();
+    if(half.rows() != nx || half.cols() != ny/2 + 1) return 1;
+
+    for(int i = 0; i < nx; i ++ ) {
+        // the row that holds the mirror image of row i
+        int mirror_i = (nx - i) % nx;
+        for(int j = 0; j < ny; j ++ ) {
+            if(j <= ny/2)
+                full[i][j] = half(i, j);
+            else
+                full[i][j] = conj(half(mirror_i, ny - j));
+        }
+    }
+    return 0;
+}
+
+template <typename T, typename R>
+void zoom_dft(const BasicArray2d<T> &in, double dx, double dy, const vector<double> &ps, const vector<double> &qs, BasicArray2d<complex<R>> &out) {
+    int m_p = ps.size(), m_q = qs.size();
+
+    // only the part of in that isn't zero
+    int first_row, last_row;
+    nonzero_rows(in, first_row, last_row);
+    int first_col = in.cols(), last_col = 0;
+    for(int i = first_row; i < last_row; i ++ )
+        for(int j = 0; j < in.cols(); j ++ )
+            if(in(i, j) != T(0.0)) {
+                first_col = min(first_col, j);
+                last_col = max(last_col, j + 1);
+            }
+    int n_rows = last_row - first_row, n_cols = max(last_col - first_col, 0);
+
+    // the kernels exp(-i theta) = cos(theta) - i sin(theta), one row per frequency.
+    // The complex products are written out, so they don't go through the checks
+    // for infinities that complex<double> multiplication does
+    vector<double> p_cos(m_p * n_cols), p_sin(m_p * n_cols);
+    for(int l = 0; l < m_p; l ++ )
+        for(int j = 0; j < n_cols; j ++ ) {
+            double theta = ps[l] * (first_col + j) * dx;
+            p_cos[l * n_cols + j] = cos(theta);
+            p_sin[l * n_cols + j] = sin(theta);
         }
+    vector<double> q_cos(m_q * n_rows), q_sin(m_q * n_rows);
+    for(int k = 0; k < m_q; k ++ )
+        for(int i = 0; i < n_rows; i ++ ) {
+            double theta = qs[k] * (first_row + i) * dy;
+            q_cos[k * n_rows + i] = cos(theta);
+            q_sin[k * n_rows + i] = sin(theta);
+        }
+
+    // transform along the rows first, into t, n_rows by m_p
+    vector<double> t_re(n_rows * m_p), t_im(n_rows * m_p);
+    vector<double> row_re(n_cols), row_im(n_cols);
+    for(int i = 0; i < n_rows; i ++ ) {
+        const T * row = in[first_row + i] + first_col;
+        for(int j = 0; j < n_cols; j ++ ) {
+            row_re[j] = real(row[j]);
+            row_im[j] = imag(row[j]);
+        }
+        for(int l = 0; l < m_p; l ++ ) {
+            const double * c = &p_cos[l * n_cols], * s = &p_sin[l * n_cols];
+            double re = 0.0, im = 0.0;
+            for(int j = 0; j < n_cols; j ++ ) {
+                re += row_re[j] * c[j] + row_im[j] * s[j];
+                im += row_im[j] * c[j] - row_re[j] * s[j];
+            }
+            t_re[i * m_p + l] = re;
+            t_im[i * m_p + l] = im;
+        }
+    }
+
+    // then along the columns, a whole row of out at a time
+    vector<double> out_re(m_p), out_im(m_p);
+    for(int k = 0; k < m_q; k ++ ) {
+        fill(out_re.begin(), out_re.end(), 0.0);
+        fill(out_im.begin(), out_im.end(), 0.0);
+        for(int i = 0; i < n_rows; i ++ ) {
+            double c = q_cos[k * n_rows + i], s = q_sin[k * n_rows + i];
+            const double * re = &t_re[i * m_p], * im = &t_im[i * m_p];
+            for(int l = 0; l < m_p; l ++ ) {
+                out_re[l] += re[l] * c + im[l] * s;
+                out_im[l] += im[l] * c - re[l] * s;
+            }
+        }
+        complex<R> * out_row = out[k];
+        for(int l = 0; l < m_p; l ++ )
+            out_row[l] = complex<R>(out_re[l], out_im[l]);
+    }
+}
+
+/** True if any element in row i of a is non-zero */
+template <typename T>
+bool row_is_nonzero(const BasicArray2d<T> &a, int i) {
+    for(int j = 0; j < a.cols(); j ++ )
+        if(a(i, j) != T(0.0))
+            return true;
+    return false;
+}
+
+template <typename T>
+void nonzero_rows(const BasicArray2d<T> &a, int &first, int &last) {
+    // walk in from both ends, only as far as the first non-zero row
+    first = 0;
+    while(first < a.rows() && !row_is_nonzero(a, first))
+        first++;
 
-    b.copy_into(a);
+    last = a.rows();
+    while(last > first && !row_is_nonzero(a, last - 1))
+        last--;
 }
 
 /** Find the first minimum of abs(fun) along the horizontal axis in the first row */
-ValueError<double> find_first_min(complex_to_real fun, const Array2d &a, const vector<double> &xs) {
-    int i = 0, j = 1;
-    int nx = xs.size();
+template <typename P, typename T>
+ValueError<double> find_first_min(P fun, const BasicArray2d<T> &a, const vector<double> &xs, bool interpolate) {
+    // a may hold only half the row, if it came from a real-to-complex transform
+    int n = min((int)xs.size(), a.cols());
+    vector<double> vals(n);
+    for(int j = 0; j < n; j ++ )
+        vals[j] = fun(a(0, j));
+
+    return interpolate ? interpolate_first_min(vals, xs) : grid_first_min(vals, xs);
+}
+
+int first_min_index(const vector<double> &vals) {
+    int j = 1, n = vals.size();
 
     // keep walking along the row until you find a local min
-    while(j < nx-1)
-        if(fun(a(i, j-1)) > fun(a(i, j)) && fun(a(i, j)) < fun(a(i, j+1)))
+    while(j < n-1)
+        if(vals[j-1] > vals[j] && vals[j] < vals[j+1])
             break;
         else
             j++;
-
-    ValueError<double> res;
-    res.val = xs[j];
-    res.err = abs(xs[j] - xs[j-1]);
-    return res;
+    return j;
 }
 
 /**
@@ -225,32 +447,147 @@ ValueError<double> find_first_min(complex_to_real fun, const Array2d &a, const v
  * If vertical is true, the y-coordinate along the first vertical is found instead.
  * coord are the x-positions (or y-positions) of the points, depending on vertical
  */
-ValueError<double> hwhp(const Array2d &a, const vector<double> &coord, bool vertical) {
-    int j = 0;
-    int n = coord.size();
+template <typename T>
+ValueError<double> hwhp(const BasicArray2d<T> &a, const vector<double> &coord, bool vertical, bool interpolate) {
+    // a may hold only half the row, if it came from a real-to-complex transform
+    int n = min((int)coord.size(), vertical ? a.rows() : a.cols());
+    vector<double> vals(n);
+    for(int j = 0; j < n; j ++ )
+        vals[j] = vertical ? abs(a(j, 0)) : abs(a(0, j));
+
+    return interpolate ? interpolate_half_power(vals, coord) : grid_half_power(vals, coord);
+}
 
-    double max_abs = abs(a(0, 0));
-    double half_power = max_abs / sqrt(2.0);
+int half_power_index(const vector<double> &vals) {
+    int j = 0, n = vals.size();
+    double half_power = vals[0] / sqrt(2.0);
 
-    // walk along the first row or column until abs(a) drops below half_power
+    // walk along until vals drops below half_power
     while(j < n-1)
-        if(!vertical && abs(a(0, j)) < half_power)
-            break;
-        else if(vertical && abs(a(j, 0)) < half_power)
+        if(vals[j] < half_power)
             break;
         else
             j++;
-    
-    ValueError<double> res;
-    res.val = coord[j];
-    res.err = abs(coord[j] - coord[j-1]);
-    return res;
+    return j;
+}
+
+ValueError<double> grid_first_min(const vector<double> &vals, const vector<double> &coord) {
+    int j = first_min_index(vals);
+    return ValueError<double>{coord[j], abs(coord[j] - coord[j-1])};
+}
+
+ValueError<double> grid_half_power(const vector<double> &vals, const vector<double> &coord) {
+    int j = half_power_index(vals);
+    return ValueError<double>{coord[j], abs(coord[j] - coord[j-1])};
+}
+
+/** True if coord is evenly spaced from first to last (inclusive), which it isn't
+ * across the jump from the positive to the negative frequencies
+ */
+bool evenly_spaced(const vector<double> &coord, int first, int last) {
+    if(first < 0 || last >= (int)coord.size()) return false;
+    double step = coord[first + 1] - coord[first];
+    for(int j = first + 1; j < last; j ++ )
+        if(!DBL_EQ(coord[j + 1] - coord[j], step)) return false;
+    return true;
+}
+
+/** Offset from the middle point, in grid steps, of the vertex of the parabola through
+ * the values sm, s0, sp at -1, 0 and 1. Returns false if it has no minimum.
+ */
+bool parabola_min(double sm, double s0, double sp, double &offset) {
+    double curvature = sm - 2*s0 + sp;
+    if(curvature <= 0.0) return false;
+    offset = 0.5 * (sm - sp) / curvature;
+    return true;
+}
+
+/** Position t in [lo, hi], in grid steps from the first point, of the minimum of the cubic
+ * through the values y[0] to y[3] at 0, 1, 2 and 3. Returns false if it has none there.
+ */
+bool cubic_min(const double * y, double lo, double hi, double &t) {
+    // differences of the Newton form, then the derivative A t^2 + B t + C
+    double d1 = y[1] - y[0], d2 = y[2] - 2*y[1] + y[0], d3 = y[3] - 3*y[2] + 3*y[1] - y[0];
+    double a = d3 / 2, b = d2 - d3, c = d1 - d2 / 2 + d3 / 3;
+
+    // the root where the second derivative 2 A t + B is positive
+    if(abs(a) <= EPS * abs(b)) {
+        if(b <= 0.0) return false;
+        t = -c / b;
+    }
+    else {
+        double disc = b*b - 4*a*c;
+        if(disc < 0.0) return false;
+        t = (-b + sqrt(disc)) / (2*a);
+    }
+    return t >= lo && t <= hi;
+}
+
+ValueError<double> interpolate_first_min(const vector<double> &vals, const vector<double> &coord) {
+    ValueError<double> grid = grid_first_min(vals, coord);
+    int j = first_min_index(vals), n = vals.size();
+    if(j + 1 >= n || !evenly_spaced(coord, j - 1, j + 1)) return grid;
+
+    // the squared magnitude is smooth through the minimum, even if it's a zero, and the magnitude isn't
+    vector<double> sq(4);
+    auto square = [&](int k) { return vals[k] * vals[k]; };
+    double step = coord[j + 1] - coord[j], offset;
+    if(!parabola_min(square(j - 1), square(j), square(j + 1), offset)) return grid;
+    double x_parabola = coord[j] + offset * step;
+
+    // the cubic through one more point, on the side the minimum is on, gets rid of most of
+    // the error of the parabola, and how far apart they are is a generous estimate of what's left
+    int first = (offset > 0) ? j - 1 : j - 2;
+    if(first < 0 || first + 3 >= n || !evenly_spaced(coord, first, first + 3))
+        return ValueError<double>{x_parabola, abs(step) / 2};
+    for(int k = 0; k < 4; k ++ )
+        sq[k] = square(first + k);
+    double t;
+    if(!cubic_min(sq.data(), j - 1 - first, j + 1 - first, t))
+        return ValueError<double>{x_parabola, abs(step) / 2};
+    double x = coord[first] + t * step;
+    return ValueError<double>{x, abs(x - x_parabola)};
+}
+
+ValueError<double> interpolate_half_power(const vector<double> &vals, const vector<double> &coord) {
+    ValueError<double> grid = grid_half_power(vals, coord);
+    int j = half_power_index(vals), n = vals.size();
+    double half_power = vals[0] / sqrt(2.0);
+    if(j < 1 || vals[j] >= half_power || !evenly_spaced(coord, j - 1, j)) return grid;
+
+    // where the straight line between the points either side crosses half power
+    double step = coord[j] - coord[j - 1];
+    double t = (vals[j - 1] - half_power) / (vals[j - 1] - vals[j]);
+    double x_line = coord[j - 1] + t * step;
+
+    // and where the parabola through those and the nearest other point does, between them
+    int mid = (t < 0.5 && j >= 2) ? j - 1 : j;
+    if(mid + 1 >= n || !evenly_spaced(coord, mid - 1, mid + 1))
+        return ValueError<double>{x_line, abs(step) / 2};
+    double a = 0.5 * (vals[mid + 1] - 2*vals[mid] + vals[mid - 1]);
+    double b = 0.5 * (vals[mid + 1] - vals[mid - 1]);
+    double c = vals[mid] - half_power;
+    // the root of a u^2 + b u + c = 0 in [j - 1, j], relative to mid
+    double lo = j - 1 - mid, hi = j - mid;
+    double u = lo + t;
+    if(abs(a) > EPS * abs(b)) {
+        double disc = b*b - 4*a*c;
+        if(disc < 0.0) return ValueError<double>{x_line, abs(step) / 2};
+        double q = -0.5 * (b + copysign(sqrt(disc), b));
+        if(q == 0.0) return ValueError<double>{x_line, abs(step) / 2};
+        double u1 = q / a, u2 = c / q;
+        u = (u1 >= lo && u1 <= hi) ? u1 : u2;
+        if(u < lo || u > hi) return ValueError<double>{x_line, abs(step) / 2};
+    }
+    double x = coord[mid] + u * step;
+    return ValueError<double>{x, abs(x - x_line)};
 }
 
 /**
  * Calculate the mean and standard deviation of fun within a given radius
  */
-ValueError<double> mean_stddev(complex_to_real fun, const Array2d &a, const vector<double>& xs, const vector<double>& ys, double radius) {
+template <typename P, typename T>
+ValueError<double> mean_stddev(P fun, const BasicArray2d<T> &a, const vector<double>& xs, const vector<double>& ys, double radius) {
     int n_cols = xs.size(), n_rows = ys.size();
     double rsq;
 
@@ -279,10 +616,130 @@ ValueError<double> mean_stddev(complex_to_real fun, const Array2d &a, const vect
  * in standard formatted way. 
  * Only print stuff within x and y limits given by lims.
  */
-void print_lim_array(FILE * filep, complex_to_real fun, const Array2d &a, const vector<double> &xs, const vector<double> &ys, const Limits &lims) {
+template <typename P, typename T>
+void print_lim_array(FILE * filep, P fun, const BasicArray2d<T> &a, const vector<double> &xs, const vector<double> &ys, const Limits &lims) {
     int imin = lims[0], imax = lims[1], jmin = lims[2], jmax = lims[3];
 
     fprintf(filep, "% 6.5f\t% 6.5f \n", xs[jmin], xs[jmax-1]);
     fprintf(filep, "% 6.5f\t% 6.5f \n", ys[imin], ys[imax-1]);
     a.print_prop(fun, lims, filep);
 }
+
+
+// approximate number of bytes of converted data to collect before each fwrite
+#define NPY_BLOCK_BYTES (1 << 20)
+
+/** Write the .npy header for a C-ordered n_rows x n_cols array of floats of the given size */
+void write_npy_header(FILE * filep, int n_rows, int n_cols, int float_size) {
+    // the byte order is whatever this machine uses
+    uint16_t one = 1;
+    char order = (*(char*)&one == 1) ? '<' : '>';
+
+    char dict[128];
+    int dict_len = sprintf(dict, "{'descr': '%cf%d', 'fortran_order': False, 'shape': (%d, %d), }",
+        order, float_size, n_rows, n_cols);
+
+    // magic, version 1.0, 2-byte header length, then the dict padded with
+    // spaces and a newline, so that the data starts at a multiple of 64 bytes
+    const int preamble_len = 10;
+    uint16_t header_len = ((preamble_len + dict_len + 1 + 63) / 64) * 64 - preamble_len;
+    uint8_t len_bytes[2] = {(uint8_t)(header_len & 0xff), (uint8_t)(header_len >> 8)};
+
+    fwrite("\x93NUMPY\x01\x00", 1, 8, filep);
+    fwrite(len_bytes, 1, 2, filep);
+    fwrite(dict, 1, dict_len, filep);
+    for(int i = dict_len; i < header_len - 1; i ++ )
+        fputc(' ', filep);
+    fputc('\n', filep);
+}
+
+/** Convert a block of rows with fun and write them with one fwrite */
+template <typename F, typename P, typename T>
+void write_rows(FILE * filep, P fun, const BasicArray2d<T> &a, const Limits &lims, vector<F> &buff) {
+    int imin = lims[0], imax = lims[1], jmin = lims[2], jmax = lims[3];
+    int n_cols = jmax - jmin;
+    int rows_per_block = max(1, (int)(NPY_BLOCK_BYTES / (sizeof(F) * n_cols)));
+    buff.resize(rows_per_block * n_cols);
+
+    for(int i0 = imin; i0 < imax; i0 += rows_per_block) {
+        int i1 = min(imax, i0 + rows_per_block);
+        F * dest = buff.data();
+        for(int i = i0; i < i1; i ++ )
+            for(int j = jmin; j < jmax; j ++ )
+                *(dest++) = (F) fun(a(i, j));
+        fwrite(buff.data(), sizeof(F), (i1 - i0) * n_cols, filep);
+    }
+}
+
+template <typename P, typename T>
+void save_lim_array_npy(const string &filename, const string &lims_filename, P fun, const BasicArray2d<T> &a, const vector<double> &xs, const vector<double> &ys, const Limits &lims, bool dbl) {
+    int imin = lims[0], imax = lims[1], jmin = lims[2], jmax = lims[3];
+
+    FILE * lims_filep = fopen(lims_filename.c_str(), "w");
+    if(lims_filep == NULL) throw runtime_error("Could not open " + lims_filename);
+    fprintf(lims_filep, "% 6.5f\t% 6.5f \n", xs[jmin], xs[jmax-1]);
+    fprintf(lims_filep, "% 6.5f\t% 6.5f \n", ys[imin], ys[imax-1]);
+    fclose(lims_filep);
+
+    FILE * filep = fopen(filename.c_str(), "wb");
+    if(filep == NULL) throw runtime_error("Could not open " + filename);
+    if(dbl) {
+        vector<double> buff;
+        write_npy_header(filep, imax - imin, jmax - jmin, sizeof(double));
+        write_rows(filep, fun, a, lims, buff);
+    }
+    else {
+        vector<float> buff;
+        write_npy_header(filep, imax - imin, jmax - jmin, sizeof(float));
+        write_rows(filep, fun, a, lims, buff);
+    }
+    fclose(filep);
+}
+
+
+// the element types arrays are used with
+template class BasicArray2d<complex<double>>;
+template class BasicArray2d<double>;
+template class BasicArray2d<complex<float>>;
+template class BasicArray2d<float>;
+
+#define INSTANTIATE_ARRAY_FUNCTIONS(T) \
+    template bool operator==(const BasicArray2d<T> &a, const BasicArray2d<T> &b); \
+    template void fftshift(BasicArray2d<T> &a); \
+    template void checkerboard(BasicArray2d<T> &a); \
+    template void nonzero_rows(const BasicArray2d<T> &a, int &first, int &last); \
+    template ValueError<double> hwhp(const BasicArray2d<T> &a, const vector<double> &coord, bool vertical, bool interpolate);
+
+// and the projections they're used with
+#define INSTANTIATE_PROJECTION_FUNCTIONS(T, P) \
+    template Limits BasicArray2d<T>::find_interesting(P fun, double abs_sens, double rel_sens) const; \
+    template void BasicArray2d<T>::print_prop(P fun, FILE * out_file) const; \
+    template void BasicArray2d<T>::print_prop(P fun, const Limits &lim, FILE * out_file) const; \
+    template ValueError<double> find_first_min(P fun, const BasicArray2d<T> &a, const vector<double> &xs, bool interpolate); \
+    template ValueError<double> mean_stddev(P fun, const BasicArray2d<T> &a, const vector<double>& xs, const vector<double>& ys, double radius); \
+    template void print_lim_array(FILE * filep, P fun, const BasicArray2d<T> &a, const vector<double> &xs, const vector<double> &ys, const Limits &lims); \
+    template void save_lim_array_npy(const string &filename, const string &lims_filename, P fun, const BasicArray2d<T> &a, const vector<double> &xs, const vector<double> &ys, const Limits &lims, bool dbl);
+
+#define INSTANTIATE_ALL_PROJECTIONS(T) \
+    INSTANTIATE_PROJECTION_FUNCTIONS(T, Abs) \
+    INSTANTIATE_PROJECTION_FUNCTIONS(T, Arg) \
+    INSTANTIATE_PROJECTION_FUNCTIONS(T, Re) \
+    INSTANTIATE_PROJECTION_FUNCTIONS(T, Complexness) \
+    INSTANTIATE_PROJECTION_FUNCTIONS(T, Norm)
+
+INSTANTIATE_ARRAY_FUNCTIONS(complex<double>)
+INSTANTIATE_ARRAY_FUNCTIONS(double)
+INSTANTIATE_ARRAY_FUNCTIONS(complex<float>)
+INSTANTIATE_ARRAY_FUNCTIONS(float)
+INSTANTIATE_ALL_PROJECTIONS(complex<double>)
+INSTANTIATE_ALL_PROJECTIONS(double)
+INSTANTIATE_ALL_PROJECTIONS(complex<float>)
+INSTANTIATE_ALL_PROJECTIONS(float)
+
+template int expand_hermitian(const BasicArray2d<complex<double>> &half, BasicArray2d<complex<double>> &full);
+template int expand_hermitian(const BasicArray2d<complex<float>> &half, BasicArray2d<complex<float>> &full);
+
+template void zoom_dft(const BasicArray2d<complex<double>> &in, double dx, double dy, const vector<double> &ps, const vector<double> &qs, BasicArray2d<complex<double>> &out);
+template void zoom_dft(const BasicArray2d<double> &in, double dx, double dy, const vector<double> &ps, const vector<double> &qs, BasicArray2d<complex<double>> &out);
+template void zoom_dft(const BasicArray2d<complex<float>> &in, double dx, double dy, const vector<double> &ps, const vector<double> &qs, BasicArray2d<complex<float>> &out);
+template void zoom_dft(const BasicArray2d<float> &in, double dx, double dy, const vector<double> &ps, const vector<double> &qs, BasicArray2d<complex<float>> &out);
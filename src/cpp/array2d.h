@@ -6,6 +6,7 @@
 #include<vector>
 #include<array>
 #include<string>
+#include<memory>
 
 #include<fftw3.h>
 
@@ -18,73 +19,245 @@ using namespace std;
 using Limits = array<int, 4>;
 string lims_to_str(const Limits &l);
 
-/** THE class that stores a 2D nx by ny array of complex<double> numbers
+/** Maps the element type of an array to the type FFTW uses for it */
+template <typename T> struct fftw_type;
+template <> struct fftw_type<complex<double>> { using type = fftw_complex; };
+template <> struct fftw_type<double> { using type = double; };
+template <> struct fftw_type<complex<float>> { using type = fftwf_complex; };
+template <> struct fftw_type<float> { using type = float; };
+
+/** THE class that stores a 2D nx by ny array of numbers of type T
  * internally represented as a 1D array of length (nx*ny). It offers access
  * to elements in mutable and immutable ways, (approximate) equality comparison.
+ * T is complex<double> for most things (see Array2d below), or double
+ * for apertures that are real (RealArray2d). The same again in single precision
+ * (Array2df and RealArray2df) take half the memory, for grids too large for double.
  * 
+ * The numbers are normally kept in memory. Arrays constructed with a scratch
+ * directory are mapped from a file there instead, for grids too large for memory:
+ * only the parts being worked on are loaded, by the operating system. Everything
+ * works the same on them, but anything that goes down the columns is slow, so they
+ * should be transformed with the tiled plans in fft.h.
+ *
  * NB it doesn't follow the rule of 3 for classes having pointer members.
  * This means that the (compiler-generated) copy constructor will not deep-copy
  * the data stored within, but rather just copy the pointer arr. This is done
  * on purpose to save time and memory when deep-copying isn't necessary.
  */
-class Array2d {
+template <typename T>
+class BasicArray2d {
 private:
     int nx, ny;
-    complex<double> * arr;
+    T * arr;
+    size_t mapped_bytes;    // 0 unless the array is mapped from a file
 
 public:
-    Array2d(int size_x, int size_y);
-    ~Array2d();
-
-    complex<double> * operator[](int ix);
-    complex<double> operator()(int ix, int iy) const;
-    int mult(const Array2d& a);
-    int mult_each(complex<double> c);
-    int divide_each(complex<double> c);
-    friend bool operator==(const Array2d &a, const Array2d &b);
+    BasicArray2d(int size_x, int size_y);
+    BasicArray2d(int size_x, int size_y, const string &scratch_dir);
+    ~BasicArray2d();
+
+    T * operator[](int ix);
+    const T * operator[](int ix) const;
+    T operator()(int ix, int iy) const;
+    int rows() const;
+    int cols() const;
+    bool is_mapped() const;
+    int mult(const BasicArray2d& a);
+    int mult_each(T c);
+    int divide_each(T c);
+    template <typename U> friend bool operator==(const BasicArray2d<U> &a, const BasicArray2d<U> &b);
     
-    fftw_complex * ptr();
-    Limits find_interesting(complex_to_real fun, double abs_sens, double rel_sens) const;
-    void print_prop(complex_to_real fun, FILE * out_file) const;
-    void print_prop(complex_to_real fun, const Limits &lim, FILE * out_file) const;
+    typename fftw_type<T>::type * ptr();
+    template <typename P> Limits find_interesting(P fun, double abs_sens, double rel_sens) const;
+    template <typename P> void print_prop(P fun, FILE * out_file) const;
+    template <typename P> void print_prop(P fun, const Limits &lim, FILE * out_file) const;
     
-    int copy_into(Array2d &a) const;
+    int copy_into(BasicArray2d &a) const;
 
-    friend void fftshift(Array2d &a);
+    template <typename U> friend void fftshift(BasicArray2d<U> &a);
 };
 
+using Array2d = BasicArray2d<complex<double>>;
+using RealArray2d = BasicArray2d<double>;
+using Array2df = BasicArray2d<complex<float>>;
+using RealArray2df = BasicArray2d<float>;
+
+/**
+ * Multiply element (i, j) of a by (-1)^(i+j). For even sizes, doing this to the input
+ * of a DFT shifts its output by half the array in both directions, just like
+ * fftshift would afterwards, but in one streaming pass and without moving anything.
+ */
+template <typename T>
+void checkerboard(BasicArray2d<T> &a);
+
+/**
+ * Fill full (nx by ny) with the spectrum whose non-negative frequency half along the
+ * columns is in half (nx by ny/2 + 1), which is how FFTW returns the transform of
+ * real data. The other half is found from the Hermitian symmetry of that transform.
+ * Returns non-zero if the sizes don't match.
+ */
+template <typename T>
+int expand_hermitian(const BasicArray2d<T> &half, BasicArray2d<T> &full);
+
+/**
+ * Matrix Fourier transform: the DFT of in at any frequencies, rather than only the
+ * evenly spaced ones the FFT gives. Row k, column l of out (qs.size() by ps.size())
+ * is the sum over i, j of in[i][j] exp(-i (qs[k] i dy + ps[l] j dx)), which for
+ * ps[l] = 2 pi l / (ny dx) and qs[k] = 2 pi k / (nx dy) is the forward FFT of in.
+ * So a fine grid over a small window of the image can be had from a modest array.
+ * It takes O(nx ny ps.size() + nx ps.size() qs.size()) operations, over the rows and
+ * columns of in that aren't all zero.
+ */
+template <typename T, typename R>
+void zoom_dft(const BasicArray2d<T> &in, double dx, double dy, const vector<double> &ps, const vector<double> &qs, BasicArray2d<complex<R>> &out);
+
+/**
+ * Find the range of rows of a that have any non-zero elements in them, from first
+ * (inclusive) to last (exclusive). If the whole array is zero, first == last.
+ */
+template <typename T>
+void nonzero_rows(const BasicArray2d<T> &a, int &first, int &last);
+
+/**
+ * Index of the first local minimum in vals, walking from the start.
+ * If there is none, the index of the last-but-one element.
+ */
+int first_min_index(const vector<double> &vals);
+
+/**
+ * Index of the first element of vals that is below vals[0] / sqrt(2),
+ * i.e. the first point under half power. If there is none, the last index.
+ */
+int half_power_index(const vector<double> &vals);
+
+/**
+ * Position in coord of the first minimum of vals and of the first point under half power,
+ * with their errors. The grid_ ones are the grid points found by first_min_index and
+ * half_power_index, and their error is the grid spacing. The interpolate_ ones are
+ * in between the grid points: the minimum of a cubic through the squares of vals
+ * around the first minimum, and where a parabola through vals crosses half power.
+ * Their error is how far off the fit of one order less is, which overestimates it.
+ * Where there aren't enough points to fit (at the ends of vals), they give the grid point.
+ */
+ValueError<double> grid_first_min(const vector<double> &vals, const vector<double> &coord);
+ValueError<double> grid_half_power(const vector<double> &vals, const vector<double> &coord);
+ValueError<double> interpolate_first_min(const vector<double> &vals, const vector<double> &coord);
+ValueError<double> interpolate_half_power(const vector<double> &vals, const vector<double> &coord);
+
 /**
  * Find the first minimum of fun(z) along the horizontal axis of a
- * and the associated error
+ * and the associated error. In between the grid points if interpolate.
  */
-ValueError<double> find_first_min(complex_to_real fun, const Array2d &a, const vector<double> &xs);
+template <typename P, typename T>
+ValueError<double> find_first_min(P fun, const BasicArray2d<T> &a, const vector<double> &xs, bool interpolate = false);
 
 /**
- * Find the x-coordinate of the first half-power point and the error
+ * Find the x-coordinate of the first half-power point and the error.
+ * In between the grid points if interpolate.
  */
-ValueError<double> hwhp(const Array2d &a, const vector<double> &coord, bool vertical = false);
+template <typename T>
+ValueError<double> hwhp(const BasicArray2d<T> &a, const vector<double> &coord, bool vertical = false, bool interpolate = false);
 
 /**
  * Calculate the mean and standard deviation of fun within a given radius
  */
-ValueError<double> mean_stddev(complex_to_real fun, const Array2d &a, const vector<double>& xs, const vector<double>& ys, double radius);
+template <typename P, typename T>
+ValueError<double> mean_stddev(P fun, const BasicArray2d<T> &a, const vector<double>& xs, const vector<double>& ys, double radius);
 
 /**
  * Print the limits in two dihections of the 2d array, then the array itself,
  * in standard formatted way. 
  * Only print stuff within x and y limits given by lims.
  */
-void print_lim_array(FILE * filep, complex_to_real fun, const Array2d &a, const vector<double> &xs, const vector<double> &ys, const Limits &lims);
+template <typename P, typename T>
+void print_lim_array(FILE * filep, P fun, const BasicArray2d<T> &a, const vector<double> &xs, const vector<double> &ys, const Limits &lims);
+
+/**
+ * Same as print_lim_array, but binary: the array within lims goes to filename as
+ * a NumPy .npy file of float32 (float64 if dbl is true), and the two lines of
+ * limits that print_lim_array would put at the top go to the text file lims_filename.
+ */
+template <typename P, typename T>
+void save_lim_array_npy(const string &filename, const string &lims_filename, P fun, const BasicArray2d<T> &a, const vector<double> &xs, const vector<double> &ys, const Limits &lims, bool dbl);
 
 /**
  * Type of function that writes and aperture an aperture given
- * the list of x and y coordinates and a vector of parameters.
+ * the list of x and y coordinates and a vector of parameters,
+ * into a complex array of precision R.
+ */
+template <typename R>
+using basic_aperture_generator = int (*)(BasicArray2d<complex<R>>& arr, const vector<double>& xs, const vector<double>& ys, const vector<double>& params);
+
+/** Same, for apertures that are real everywhere, written into a real array */
+template <typename R>
+using basic_real_aperture_generator = int (*)(BasicArray2d<R>& arr, const vector<double>& xs, const vector<double>& ys, const vector<double>& params);
+
+using aperture_generator = basic_aperture_generator<double>;
+using real_aperture_generator = basic_real_aperture_generator<double>;
+
+/** An entry in the generators map. real_gen writes the same aperture as gen, but
+ * into a real array, and is only there (not NULL) for apertures that are real.
+ * Those can be transformed with a real-to-complex FFT, in half the time and memory.
+ */
+template <typename R>
+struct BasicGenerator {
+    basic_aperture_generator<R> gen;
+    basic_real_aperture_generator<R> real_gen;
+};
+using Generator = BasicGenerator<double>;
+
+/** map the name found in config files to the actual function pointers
+ * for dynamically choosing which functions to run.
+ * generators_f has the same ones, drawing into single precision arrays.
  */
-using aperture_generator = int (*)(Array2d& arr, const vector<double>& xs, const vector<double>& ys, const vector<double>& params);
+extern map<string, Generator> generators;
+extern map<string, BasicGenerator<float>> generators_f;
+
+/** generators or generators_f, for arrays of precision R */
+template <typename R>
+const map<string, BasicGenerator<R>>& generators_for();
 
-/** map the name found in config files to the actual function pointer
- * for dynamically choosing which functions to run
+/** The radially symmetric apertures, by the amplitude a(r) along the radius instead of
+ * on a grid. support gives the radii r_min <= r <= r_max outside which a(r) is zero.
+ */
+struct RadialGenerator {
+    void (*support)(const vector<double>& params, double &r_min, double &r_max);
+    double (*amplitude)(double r, const vector<double>& params);
+};
+
+/** The generators that are radially symmetric, by the same names as in generators */
+extern map<string, RadialGenerator> radial_generators;
+
+/**
+ * The image of the radially symmetric aperture gen with params at the frequencies
+ * ps[first] .. ps[last - 1], into the same elements of image, which is made longer if need be.
+ * That's the Hankel transform F(p) = 2 pi int a(r) J0(p r) r dr, times scale, which is
+ * 1/(dx dy) to be in the same units as the FFT of the aperture drawn with spacings dx, dy.
+ */
+void radial_image(const RadialGenerator &gen, const vector<double> &params, const vector<double> &ps, int first, int last, double scale, vector<double> &image);
+
+/** Settings shared by all the generators, set from the config before any shape is drawn.
+ * With counter_rng, the random apertures take their random numbers from the counter-based
+ * philox generator instead of GSL's. Then every element is drawn independently of the
+ * others, so the rows can be split over `threads` threads and still come out the same.
+ */
+struct GeneratorSettings {
+    bool counter_rng;
+    int threads;
+    bool analytic_mask;     // write the gaussian mask of corr_errors straight into frequency space
+};
+extern GeneratorSettings gen_settings;
+
+/**
+ * The spectrum of the gaussian mask of correlation length lc on the grid xs, ys,
+ * which corr_errors multiplies the spectrum of the errors by. If modulate, it's
+ * multiplied by (-1)^(i+j), as done by checkerboard. If analytic, the transfer
+ * function is written straight away instead of transforming the mask.
+ * Every spectrum is only worked out once and then shared by all threads, while it's
+ * in the cache; the most recently used ones are kept there.
+ * R is the precision of the spectrum, the same as that of the arrays it's used on.
  */
-extern map<string, aperture_generator> generators;
+template <typename R = double>
+shared_ptr<const BasicArray2d<complex<R>>> mask_spectrum(const vector<double>& xs, const vector<double>& ys, double lc, bool modulate, bool analytic);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,379 @@
+#include<cstdio>
+#include<cstring>
+#include<ctime>
+#include<chrono>
+#include<algorithm>
+#include<map>
+#include<thread>
+
+#include<unistd.h>
+#include<fftw3.h>
+
+#include "analysis.h"
+#include "array2d.h"
+#include "fft.h"
+
+using namespace std;
+
+#define INFO_OUT true
+
+#define USAGE "Usage: bench.exe [--out file] [--reps N] [--micro-size n] [--sizes n1,n2,...] [--threads N] [--estimate]\n" \
+    "       bench.exe --compare old_file new_file [--tolerance t]"
+
+// where the results go by default, relative to the working directory
+#define BENCH_OUT "data/bench.txt"
+
+// side of the area the apertures are drawn in, and the parameters they're drawn with,
+// which are like those of config/corr_big.txt
+#define BENCH_LX 64.0
+#define BENCH_PARAMS {6.0, 3.0, 1.0, 0.15708, 14728, 0.15}
+
+// the tasks done on every shape by the pipeline benchmarks
+#define PIPELINE_TASKS {"find_min", "fwhp", "fwhp_y", "central_amplitude", "in_phase_stat", "out_lims"}
+
+// differences in time smaller than this are the noise of the timer, not regressions
+#define MIN_DIFF_MS 0.05
+
+// only do the pipeline at sizes whose arrays take less than this fraction of the memory
+#define MAX_MEMORY_FRACTION 0.8
+
+Logger bench_log(stdout, "bench.cpp", INFO_OUT);
+
+/** Options given on the command line */
+struct BenchOptions {
+    string out_filename = BENCH_OUT;
+    int reps = 3;
+    int micro_size = 2048;
+    vector<int> sizes = {1024, 2048, 4096, 8192, 16384};
+    int threads = 1;
+    bool estimate = false;
+    // compare mode: the two result files, and how much slower is a regression
+    const char * old_filename = NULL;
+    const char * new_filename = NULL;
+    double tolerance = 0.1;
+};
+
+/** The times one benchmark took, in ms, at one size */
+struct BenchResult {
+    string name;
+    int size;
+    vector<double> ms;
+};
+
+
+/** Time f() reps times, after one run that isn't timed, so that plans and caches are
+ * ready. setup() is called before each run, and isn't timed either.
+ */
+template <typename S, typename F>
+BenchResult time_reps(const string &name, int size, int reps, S setup, F f) {
+    BenchResult res{name, size, {}};
+    setup();
+    f();
+    for(int r = 0; r < reps; r ++ ) {
+        setup();
+        auto start = chrono::steady_clock::now();
+        f();
+        auto end = chrono::steady_clock::now();
+        res.ms.push_back(chrono::duration<double, milli>(end - start).count());
+    }
+    bench_log(name + " at " + to_string(size) + ": " + to_string(*min_element(res.ms.begin(), res.ms.end())) + " ms");
+    return res;
+}
+
+template <typename F>
+BenchResult time_reps(const string &name, int size, int reps, F f) {
+    return time_reps(name, size, reps, [] {}, f);
+}
+
+/** Time f() once, for what only takes time the first time, like planning */
+template <typename F>
+BenchResult time_once(const string &name, int size, F f) {
+    auto start = chrono::steady_clock::now();
+    f();
+    auto end = chrono::steady_clock::now();
+    BenchResult res{name, size, {chrono::duration<double, milli>(end - start).count()}};
+    bench_log(name + " at " + to_string(size) + ": " + to_string(res.ms[0]) + " ms");
+    return res;
+}
+
+double median(vector<double> v) {
+    sort(v.begin(), v.end());
+    int n = v.size();
+    return (n % 2 == 1) ? v[n/2] : 0.5 * (v[n/2 - 1] + v[n/2]);
+}
+
+
+/** Every generator, on complex arrays, and on real ones for those that have them */
+void bench_generators(int n, int reps, vector<BenchResult> &results) {
+    vector<double> xs = coords(BENCH_LX, n), ys = coords(BENCH_LX, n);
+    vector<double> params = BENCH_PARAMS;
+    Array2d in(n, n);
+    RealArray2d real_in(n, n);
+
+    for(auto &g : generators) {
+        Generator gen = g.second;
+        results.push_back(time_reps("generate/" + g.first, n, reps, [&] { gen.gen(in, xs, ys, params); }));
+        if(gen.real_gen != NULL)
+            results.push_back(time_reps("generate_real/" + g.first, n, reps, [&] { gen.real_gen(real_in, xs, ys, params); }));
+    }
+}
+
+/** The operations on whole arrays that the worker does on every shape */
+void bench_array_ops(int n, int reps, vector<BenchResult> &results) {
+    vector<double> xs = coords(BENCH_LX, n), ys = coords(BENCH_LX, n);
+    vector<double> params = BENCH_PARAMS;
+    Array2d a(n, n), b(n, n);
+    // something that looks like an aperture with errors, and the same again
+    generators.at("rand_errors").gen(a, xs, ys, params);
+    a.copy_into(b);
+
+    results.push_back(time_reps("fftshift", n, reps, [&] { fftshift(a); }));
+    results.push_back(time_reps("find_interesting", n, reps, [&] { a.find_interesting(myabs, 0.0, 0.05); }));
+    results.push_back(time_reps("mean_stddev", n, reps, [&] { mean_stddev(myarg, a, xs, ys, params[0]); }));
+    results.push_back(time_reps("copy_into", n, reps, [&] { a.copy_into(b); }));
+    // b goes back to a copy of a first, so the numbers don't blow up
+    results.push_back(time_reps("mult", n, reps, [&] { a.copy_into(b); }, [&] { b.mult(a); }));
+}
+
+/** A shape of size n, the way the worker does it with the default settings: draw it,
+ * sweep it, transform it and sweep the transform. Once for a real aperture, with a
+ * real-to-complex transform, and once for corr_errors. The planning is timed on its own.
+ */
+void bench_pipeline(int n, int reps, vector<BenchResult> &results) {
+    vector<double> xs = coords(BENCH_LX, n), ys = coords(BENCH_LX, n);
+    vector<double> ps = fftfreq(n, BENCH_LX/n/(2*M_PI));
+    vector<double> params = BENCH_PARAMS;
+    AnalysisEngine engine(PIPELINE_TASKS, 0.0, 0.05);
+    ShapeResults res;
+
+    {
+        RealArray2d in(n, n);
+        Array2d half(n, n/2 + 1);
+        fftw_plan plan;
+        results.push_back(time_once("plan_r2c", n, [&] { plan = shared_plan_r2c(n, n, in.ptr(), half.ptr()); }));
+        results.push_back(time_reps("pipeline/circular", n, reps, [&] {
+            generators.at("circular").real_gen(in, xs, ys, params);
+            engine.analyse_in(in, xs, ys, params[0], res);
+            execute_dft_r2c(plan, in.ptr(), half.ptr());
+            engine.analyse_out(half, n, ps, ps, res);
+        }));
+    }
+    {
+        Array2d in(n, n);
+        fftw_plan plan;
+        results.push_back(time_once("plan", n, [&] { plan = shared_plan(n, n, FFTW_FORWARD, in.ptr(), in.ptr()); }));
+        results.push_back(time_reps("pipeline/corr_errors", n, reps, [&] {
+            generators.at("corr_errors").gen(in, xs, ys, params);
+            engine.analyse_in(in, xs, ys, params[0], res);
+            execute_dft(plan, in.ptr(), in.ptr());
+            engine.analyse_out(in, n, ps, ps, res);
+        }));
+    }
+}
+
+
+/** The machine and the settings the results are for, as "key = value" */
+vector<pair<string, string>> host_info(const BenchOptions &opts) {
+    char buff[256] = "unknown";
+    gethostname(buff, sizeof(buff));
+    string host = buff;
+
+    string cpu = "unknown";
+    FILE * filep = fopen("/proc/cpuinfo", "r");
+    if(filep != NULL) {
+        while(fgets(buff, sizeof(buff), filep) != NULL)
+            if(strncmp(buff, "model name", 10) == 0) {
+                char * colon = strchr(buff, ':');
+                cpu = string(colon + 2, strcspn(colon + 2, "\n"));
+                break;
+            }
+        fclose(filep);
+    }
+
+    double memory_gb = (double)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGE_SIZE) / (1 << 30);
+    time_t now = time(NULL);
+    strftime(buff, sizeof(buff), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    return {
+        {"host", host},
+        {"cpu", cpu},
+        {"cores", to_string(thread::hardware_concurrency())},
+        {"memory_gb", to_string(memory_gb)},
+        {"fftw", fftw_version},
+        {"fftw_threads", to_string(opts.threads)},
+        {"planner", opts.estimate ? "estimate" : "measure"},
+        {"compiler", __VERSION__},
+        {"date", buff},
+        {"reps", to_string(opts.reps)}
+    };
+}
+
+/** Write the results: the host info as "# key = value" lines, then one tab-separated line
+ * per benchmark and size, with the median and minimum time in ms
+ */
+bool write_results(const string &filename, const vector<pair<string, string>> &info, const vector<BenchResult> &results) {
+    FILE * filep = fopen(filename.c_str(), "w");
+    if(filep == NULL) return false;
+
+    for(const pair<string, string> &kv : info)
+        fprintf(filep, "# %s = %s\n", kv.first.c_str(), kv.second.c_str());
+    fprintf(filep, "bench\tsize\tmedian_ms\tmin_ms\n");
+    for(const BenchResult &r : results)
+        fprintf(filep, "%s\t%d\t%.4f\t%.4f\n", r.name.c_str(), r.size, median(r.ms), *min_element(r.ms.begin(), r.ms.end()));
+    return fclose(filep) == 0;
+}
+
+/** Read a file written by write_results into the host info and the median times,
+ * by "bench size". Returns false if it can't be read.
+ */
+bool read_results(const char * filename, map<string, string> &info, map<string, double> &medians) {
+    FILE * filep = fopen(filename, "r");
+    if(filep == NULL) return false;
+
+    char buff[1024], name[256];
+    int size;
+    double med, mn;
+    while(fgets(buff, sizeof(buff), filep) != NULL) {
+        if(buff[0] == '#') {
+            char * eq = strstr(buff, " = ");
+            if(eq != NULL)
+                info[string(buff + 2, eq)] = string(eq + 3, strcspn(eq + 3, "\n"));
+        }
+        else if(sscanf(buff, "%255s\t%d\t%lf\t%lf", name, &size, &med, &mn) == 4)
+            medians[string(name) + " " + to_string(size)] = med;
+    }
+    fclose(filep);
+    return true;
+}
+
+/** Compare the median times of two result files. Every benchmark that is more than
+ * tolerance (and MIN_DIFF_MS) slower in the new one is a regression. Returns the number of those.
+ */
+int compare(const BenchOptions &opts) {
+    map<string, string> old_info, new_info;
+    map<string, double> old_ms, new_ms;
+    if(!read_results(opts.old_filename, old_info, old_ms) || !read_results(opts.new_filename, new_info, new_ms)) {
+        bench_log("Could not read the result files");
+        return -1;
+    }
+
+    // times from different machines or settings can't really be compared
+    for(const char * key : {"host", "cpu", "fftw", "fftw_threads", "planner"})
+        if(old_info[key] != new_info[key])
+            bench_log(string("Warning: ") + key + " is different: " + old_info[key] + " / " + new_info[key]);
+
+    int regressions = 0, missing = 0;
+    printf("%-32s %8s %12s %12s %8s\n", "bench", "size", "old_ms", "new_ms", "ratio");
+    for(const pair<const string, double> &o : old_ms) {
+        map<string, double>::const_iterator n = new_ms.find(o.first);
+        if(n == new_ms.end()) {
+            missing ++;
+            continue;
+        }
+
+        double ratio = n->second / o.second;
+        bool noise = abs(n->second - o.second) < MIN_DIFF_MS;
+        const char * flag = "";
+        if(noise) {}
+        else if(ratio > 1.0 + opts.tolerance) {
+            flag = "REGRESSION";
+            regressions ++;
+        }
+        else if(ratio < 1.0 - opts.tolerance)
+            flag = "faster";
+
+        char name[256];
+        int size;
+        sscanf(o.first.c_str(), "%255s %d", name, &size);
+        printf("%-32s %8d %12.3f %12.3f %8.3f %s\n", name, size, o.second, n->second, ratio, flag);
+    }
+    if(missing > 0 || new_ms.size() + missing != old_ms.size())
+        bench_log("Warning: not all the benchmarks are in both files");
+    bench_log(to_string(regressions) + " regressions of more than " + to_string((int)(opts.tolerance * 100)) + "%");
+    return regressions;
+}
+
+
+/** Parse the command line into opts. Returns false if it doesn't make sense */
+bool parse_args(int argc, char * argv[], BenchOptions &opts) {
+    for(int i = 1; i < argc; i ++ ) {
+        string arg = argv[i];
+        bool has_value = (i + 1 < argc);
+        if(arg == "--out" && has_value)
+            opts.out_filename = argv[++i];
+        else if(arg == "--reps" && has_value)
+            opts.reps = atoi(argv[++i]);
+        else if(arg == "--micro-size" && has_value)
+            opts.micro_size = atoi(argv[++i]);
+        else if(arg == "--threads" && has_value)
+            opts.threads = atoi(argv[++i]);
+        else if(arg == "--estimate")
+            opts.estimate = true;
+        else if(arg == "--tolerance" && has_value)
+            opts.tolerance = atof(argv[++i]);
+        else if(arg == "--sizes" && has_value) {
+            opts.sizes.clear();
+            for(char * tok = strtok(argv[++i], ","); tok != NULL; tok = strtok(NULL, ","))
+                opts.sizes.push_back(atoi(tok));
+        }
+        else if(arg == "--compare" && i + 2 < argc) {
+            opts.old_filename = argv[++i];
+            opts.new_filename = argv[++i];
+        }
+        else
+            return false;
+    }
+    if(opts.reps < 1 || opts.micro_size < 2 || opts.threads < 1 || opts.tolerance < 0.0) return false;
+    for(int n : opts.sizes)
+        if(n < 2) return false;
+    return true;
+}
+
+
+/** Time the parts of the program that take the time, and write how long they took,
+ * or compare two of those result files. See the readme.
+ */
+int main(int argc, char * argv[]) {
+    BenchOptions opts;
+    if(!parse_args(argc, argv, opts)) {
+        bench_log(USAGE);
+        return 1;
+    }
+
+    if(opts.old_filename != NULL) {
+        int regressions = compare(opts);
+        return (regressions == 0) ? 0 : 1;
+    }
+
+    if(fftw_init_threads() == 0) {
+        bench_log("Thread initialisation failed!");
+        return 1;
+    }
+    fftw_plan_with_nthreads(opts.threads);
+    if(opts.estimate) planner_flags = FFTW_ESTIMATE;
+
+    vector<BenchResult> results;
+    bench_log("Generators and array operations at " + to_string(opts.micro_size));
+    bench_generators(opts.micro_size, opts.reps, results);
+    bench_array_ops(opts.micro_size, opts.reps, results);
+
+    // corr_errors needs the array and the mask spectrum, of 16 bytes per element each
+    double memory = (double)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGE_SIZE);
+    for(int n : opts.sizes) {
+        if(32.0 * n * n > MAX_MEMORY_FRACTION * memory) {
+            bench_log("Skipping the pipeline at " + to_string(n) + ": not enough memory");
+            continue;
+        }
+        bench_log("Pipeline at " + to_string(n));
+        bench_pipeline(n, opts.reps, results);
+        // the plans of this size aren't needed any more
+        destroy_shared_plans();
+    }
+
+    if(!write_results(opts.out_filename, host_info(opts), results)) {
+        bench_log("Could not write " + opts.out_filename);
+        return 1;
+    }
+    bench_log("Wrote the results to " + opts.out_filename);
+    return 0;
+}
@@ -0,0 +1,298 @@
+#include "fft.h"
+#include "util.h"
+
+#include<cstring>
+
+unsigned int planner_flags = FFTW_MEASURE;
+
+// the shared plans, keyed by (kind, nx, ny, sign, in place), one registry per precision.
+// Only touched while holding planner_mtx
+using PlanKey = tuple<PlanKind, int, int, int, bool>;
+
+template <typename R>
+map<PlanKey, typename fftw_api<R>::plan> plans;
+
+/** Look up the plan for key, or make it with make_plan if there isn't one yet.
+ * The caller must be holding planner_mtx.
+ */
+template <typename R, typename F>
+typename fftw_api<R>::plan find_or_make(const PlanKey &key, F make_plan) {
+    auto found = plans<R>.find(key);
+    if(found != plans<R>.end())
+        return found->second;
+
+    typename fftw_api<R>::plan plan = make_plan();
+    plans<R>[key] = plan;
+    return plan;
+}
+
+template <typename R>
+typename fftw_api<R>::plan basic_shared_plan(int nx, int ny, int sign, typename fftw_api<R>::complex * in, typename fftw_api<R>::complex * out) {
+    lock_guard<mutex> lock(planner_mtx);
+    return find_or_make<R>(PlanKey(DFT_2D, nx, ny, sign, in == out), [&]{
+        return fftw_api<R>::plan_dft_2d(nx, ny, in, out, sign, planner_flags);
+    });
+}
+
+template <typename R>
+typename fftw_api<R>::plan basic_shared_plan_r2c(int nx, int ny, R * in, typename fftw_api<R>::complex * out) {
+    lock_guard<mutex> lock(planner_mtx);
+    return find_or_make<R>(PlanKey(R2C_2D, nx, ny, FFTW_FORWARD, (void*)in == (void*)out), [&]{
+        return fftw_api<R>::plan_dft_r2c_2d(nx, ny, in, out, planner_flags);
+    });
+}
+
+fftw_plan shared_plan(int nx, int ny, int sign, fftw_complex * in, fftw_complex * out) {
+    return basic_shared_plan<double>(nx, ny, sign, in, out);
+}
+fftwf_plan shared_plan(int nx, int ny, int sign, fftwf_complex * in, fftwf_complex * out) {
+    return basic_shared_plan<float>(nx, ny, sign, in, out);
+}
+fftw_plan shared_plan_r2c(int nx, int ny, double * in, fftw_complex * out) {
+    return basic_shared_plan_r2c<double>(nx, ny, in, out);
+}
+fftwf_plan shared_plan_r2c(int nx, int ny, float * in, fftwf_complex * out) {
+    return basic_shared_plan_r2c<float>(nx, ny, in, out);
+}
+
+bool can_prune(int nx) {
+    return nx % PRUNE_BLOCK == 0;
+}
+
+/** The in-place transforms of all n_cols columns of an nx-row array */
+template <typename R>
+typename fftw_api<R>::plan columns_plan(int nx, int n_cols, typename fftw_api<R>::complex * out) {
+    return find_or_make<R>(PlanKey(COLUMNS, nx, n_cols, FFTW_FORWARD, true), [&]{
+        return fftw_api<R>::plan_many_dft(nx, n_cols, out, n_cols, 1, out, n_cols, 1, FFTW_FORWARD, planner_flags);
+    });
+}
+
+template <typename R>
+BasicPrunedPlan<typename fftw_api<R>::plan> basic_pruned_plan(int nx, int ny, typename fftw_api<R>::complex * in, typename fftw_api<R>::complex * out) {
+    lock_guard<mutex> lock(planner_mtx);
+
+    BasicPrunedPlan<typename fftw_api<R>::plan> plan;
+    plan.row_plan = find_or_make<R>(PlanKey(ROW_BLOCK, PRUNE_BLOCK, ny, FFTW_FORWARD, in == out), [&]{
+        return fftw_api<R>::plan_many_dft(ny, PRUNE_BLOCK, in, 1, ny, out, 1, ny, FFTW_FORWARD, planner_flags);
+    });
+    plan.col_plan = columns_plan<R>(nx, ny, out);
+    return plan;
+}
+
+template <typename R>
+BasicPrunedPlan<typename fftw_api<R>::plan> basic_pruned_plan_r2c(int nx, int ny, R * in, typename fftw_api<R>::complex * out) {
+    lock_guard<mutex> lock(planner_mtx);
+
+    int n_out = ny/2 + 1;
+    BasicPrunedPlan<typename fftw_api<R>::plan> plan;
+    plan.row_plan = find_or_make<R>(PlanKey(R2C_ROW_BLOCK, PRUNE_BLOCK, ny, FFTW_FORWARD, false), [&]{
+        return fftw_api<R>::plan_many_dft_r2c(ny, PRUNE_BLOCK, in, ny, out, n_out, planner_flags);
+    });
+    plan.col_plan = columns_plan<R>(nx, n_out, out);
+    return plan;
+}
+
+PrunedPlan shared_pruned_plan(int nx, int ny, fftw_complex * in, fftw_complex * out) {
+    return basic_pruned_plan<double>(nx, ny, in, out);
+}
+PrunedPlanF shared_pruned_plan(int nx, int ny, fftwf_complex * in, fftwf_complex * out) {
+    return basic_pruned_plan<float>(nx, ny, in, out);
+}
+PrunedPlan shared_pruned_plan_r2c(int nx, int ny, double * in, fftw_complex * out) {
+    return basic_pruned_plan_r2c<double>(nx, ny, in, out);
+}
+PrunedPlanF shared_pruned_plan_r2c(int nx, int ny, float * in, fftwf_complex * out) {
+    return basic_pruned_plan_r2c<float>(nx, ny, in, out);
+}
+
+/** Round the rows out to whole blocks. Every block then starts at a multiple of
+ * PRUNE_BLOCK rows, so its alignment is the same as the one the plan was made for.
+ */
+void block_rows(int nx, int &first_row, int &last_row) {
+    first_row = (first_row / PRUNE_BLOCK) * PRUNE_BLOCK;
+    last_row = min(nx, ((last_row + PRUNE_BLOCK - 1) / PRUNE_BLOCK) * PRUNE_BLOCK);
+}
+
+template <typename P, typename C>
+void basic_execute_pruned(const BasicPrunedPlan<P> &plan, int nx, int ny, C * in, C * out, int first_row, int last_row) {
+    block_rows(nx, first_row, last_row);
+
+    // the zero rows stay zero
+    memset(out, 0, sizeof(C) * ny * first_row);
+    memset(out + (size_t)ny * last_row, 0, sizeof(C) * ny * (nx - last_row));
+
+    for(int i = first_row; i < last_row; i += PRUNE_BLOCK)
+        execute_dft(plan.row_plan, in + (size_t)ny * i, out + (size_t)ny * i);
+    execute_dft(plan.col_plan, out, out);
+}
+
+template <typename P, typename R, typename C>
+void basic_execute_pruned_r2c(const BasicPrunedPlan<P> &plan, int nx, int ny, R * in, C * out, int first_row, int last_row) {
+    block_rows(nx, first_row, last_row);
+    int n_out = ny/2 + 1;
+
+    memset(out, 0, sizeof(C) * n_out * first_row);
+    memset(out + (size_t)n_out * last_row, 0, sizeof(C) * n_out * (nx - last_row));
+
+    for(int i = first_row; i < last_row; i += PRUNE_BLOCK)
+        execute_dft_r2c(plan.row_plan, in + (size_t)ny * i, out + (size_t)n_out * i);
+    execute_dft(plan.col_plan, out, out);
+}
+
+void execute_pruned(const PrunedPlan &plan, int nx, int ny, fftw_complex * in, fftw_complex * out, int first_row, int last_row) {
+    basic_execute_pruned(plan, nx, ny, in, out, first_row, last_row);
+}
+void execute_pruned(const PrunedPlanF &plan, int nx, int ny, fftwf_complex * in, fftwf_complex * out, int first_row, int last_row) {
+    basic_execute_pruned(plan, nx, ny, in, out, first_row, last_row);
+}
+void execute_pruned_r2c(const PrunedPlan &plan, int nx, int ny, double * in, fftw_complex * out, int first_row, int last_row) {
+    basic_execute_pruned_r2c(plan, nx, ny, in, out, first_row, last_row);
+}
+void execute_pruned_r2c(const PrunedPlanF &plan, int nx, int ny, float * in, fftwf_complex * out, int first_row, int last_row) {
+    basic_execute_pruned_r2c(plan, nx, ny, in, out, first_row, last_row);
+}
+
+/** The column plan for tiles of nx by width, planned on a buffer like the ones
+ * execute_tiled copies the tiles into. NULL if width is 0.
+ * The caller must be holding planner_mtx.
+ */
+template <typename R>
+typename fftw_api<R>::plan tile_plan(int nx, int width) {
+    if(width == 0) return NULL;
+    using C = typename fftw_api<R>::complex;
+    C * buff = (C *) fftw_malloc(sizeof(C) * nx * width);
+    typename fftw_api<R>::plan plan = columns_plan<R>(nx, width, buff);
+    fftw_free(buff);
+    return plan;
+}
+
+/** Fill in the tile plans of plan, for arrays of nx rows and n_cols columns */
+template <typename R, typename P>
+void make_tile_plans(BasicTiledPlan<P> &plan, int nx, int n_cols, size_t tile_bytes) {
+    size_t tile_cols = tile_bytes / (sizeof(typename fftw_api<R>::complex) * nx);
+    plan.tile_cols = max(1, (int)min(tile_cols, (size_t)n_cols));
+    plan.tile_plan = tile_plan<R>(nx, plan.tile_cols);
+    plan.last_plan = tile_plan<R>(nx, n_cols % plan.tile_cols);
+}
+
+// The rows of a mapped array are only as aligned as their length allows,
+// so the row plans can't assume the alignment of the first one
+template <typename R>
+BasicTiledPlan<typename fftw_api<R>::plan> basic_tiled_plan(int nx, int ny, typename fftw_api<R>::complex * in, typename fftw_api<R>::complex * out, size_t tile_bytes) {
+    lock_guard<mutex> lock(planner_mtx);
+
+    BasicTiledPlan<typename fftw_api<R>::plan> plan;
+    plan.row_plan = find_or_make<R>(PlanKey(ROW, 1, ny, FFTW_FORWARD, in == out), [&]{
+        return fftw_api<R>::plan_many_dft(ny, 1, in, 1, ny, out, 1, ny, FFTW_FORWARD, planner_flags | FFTW_UNALIGNED);
+    });
+    make_tile_plans<R>(plan, nx, ny, tile_bytes);
+    return plan;
+}
+
+template <typename R>
+BasicTiledPlan<typename fftw_api<R>::plan> basic_tiled_plan_r2c(int nx, int ny, R * in, typename fftw_api<R>::complex * out, size_t tile_bytes) {
+    lock_guard<mutex> lock(planner_mtx);
+
+    int n_out = ny/2 + 1;
+    BasicTiledPlan<typename fftw_api<R>::plan> plan;
+    plan.row_plan = find_or_make<R>(PlanKey(R2C_ROW, 1, ny, FFTW_FORWARD, false), [&]{
+        return fftw_api<R>::plan_many_dft_r2c(ny, 1, in, ny, out, n_out, planner_flags | FFTW_UNALIGNED);
+    });
+    make_tile_plans<R>(plan, nx, n_out, tile_bytes);
+    return plan;
+}
+
+TiledPlan shared_tiled_plan(int nx, int ny, fftw_complex * in, fftw_complex * out, size_t tile_bytes) {
+    return basic_tiled_plan<double>(nx, ny, in, out, tile_bytes);
+}
+TiledPlanF shared_tiled_plan(int nx, int ny, fftwf_complex * in, fftwf_complex * out, size_t tile_bytes) {
+    return basic_tiled_plan<float>(nx, ny, in, out, tile_bytes);
+}
+TiledPlan shared_tiled_plan_r2c(int nx, int ny, double * in, fftw_complex * out, size_t tile_bytes) {
+    return basic_tiled_plan_r2c<double>(nx, ny, in, out, tile_bytes);
+}
+TiledPlanF shared_tiled_plan_r2c(int nx, int ny, float * in, fftwf_complex * out, size_t tile_bytes) {
+    return basic_tiled_plan_r2c<float>(nx, ny, in, out, tile_bytes);
+}
+
+/** The column pass of a tiled transform, over the n_cols columns of out */
+template <typename P, typename C>
+void transform_tiles(const BasicTiledPlan<P> &plan, int nx, int n_cols, C * out) {
+    C * buff = (C *) fftw_malloc(sizeof(C) * nx * plan.tile_cols);
+
+    for(int j0 = 0; j0 < n_cols; j0 += plan.tile_cols) {
+        int width = min(plan.tile_cols, n_cols - j0);
+        for(int i = 0; i < nx; i ++ )
+            memcpy(buff + width * i, out + (size_t)n_cols * i + j0, sizeof(C) * width);
+        execute_dft(width == plan.tile_cols ? plan.tile_plan : plan.last_plan, buff, buff);
+        for(int i = 0; i < nx; i ++ )
+            memcpy(out + (size_t)n_cols * i + j0, buff + width * i, sizeof(C) * width);
+    }
+    fftw_free(buff);
+}
+
+template <typename P, typename C>
+void basic_execute_tiled(const BasicTiledPlan<P> &plan, int nx, int ny, C * in, C * out, int first_row, int last_row) {
+    // the zero rows stay zero
+    memset(out, 0, sizeof(C) * ny * first_row);
+    memset(out + (size_t)ny * last_row, 0, sizeof(C) * ny * (nx - last_row));
+
+    for(int i = first_row; i < last_row; i ++ )
+        execute_dft(plan.row_plan, in + (size_t)ny * i, out + (size_t)ny * i);
+    transform_tiles(plan, nx, ny, out);
+}
+
+template <typename P, typename R, typename C>
+void basic_execute_tiled_r2c(const BasicTiledPlan<P> &plan, int nx, int ny, R * in, C * out, int first_row, int last_row) {
+    int n_out = ny/2 + 1;
+
+    memset(out, 0, sizeof(C) * n_out * first_row);
+    memset(out + (size_t)n_out * last_row, 0, sizeof(C) * n_out * (nx - last_row));
+
+    for(int i = first_row; i < last_row; i ++ )
+        execute_dft_r2c(plan.row_plan, in + (size_t)ny * i, out + (size_t)n_out * i);
+    transform_tiles(plan, nx, n_out, out);
+}
+
+void execute_tiled(const TiledPlan &plan, int nx, int ny, fftw_complex * in, fftw_complex * out, int first_row, int last_row) {
+    basic_execute_tiled(plan, nx, ny, in, out, first_row, last_row);
+}
+void execute_tiled(const TiledPlanF &plan, int nx, int ny, fftwf_complex * in, fftwf_complex * out, int first_row, int last_row) {
+    basic_execute_tiled(plan, nx, ny, in, out, first_row, last_row);
+}
+void execute_tiled_r2c(const TiledPlan &plan, int nx, int ny, double * in, fftw_complex * out, int first_row, int last_row) {
+    basic_execute_tiled_r2c(plan, nx, ny, in, out, first_row, last_row);
+}
+void execute_tiled_r2c(const TiledPlanF &plan, int nx, int ny, float * in, fftwf_complex * out, int first_row, int last_row) {
+    basic_execute_tiled_r2c(plan, nx, ny, in, out, first_row, last_row);
+}
+
+template <typename R>
+void destroy_plans() {
+    for(auto it = plans<R>.begin(); it != plans<R>.end(); it++ )
+        fftw_api<R>::destroy_plan(it->second);
+    plans<R>.clear();
+}
+
+void destroy_shared_plans() {
+    lock_guard<mutex> lock(planner_mtx);
+    destroy_plans<double>();
+    destroy_plans<float>();
+}
+
+string wisdom_filename(const string &dir, int nx, int ny, bool backward, int n_threads, bool single) {
+    char buff[100];
+    const char * tag = single ? fftw_api<float>::tag() : fftw_api<double>::tag();
+    sprintf(buff, "fftw_%s_%dx%d_%s_t%d.wisdom", tag, nx, ny, backward ? "fwdbwd" : "fwd", n_threads);
+    return dir + "/" + buff;
+}
+
+bool load_wisdom(const string &filename, bool single) {
+    if(single) return fftw_api<float>::import_wisdom(filename.c_str()) != 0;
+    return fftw_api<double>::import_wisdom(filename.c_str()) != 0;
+}
+
+bool save_wisdom(const string &filename, bool single) {
+    if(single) return fftw_api<float>::export_wisdom(filename.c_str()) != 0;
+    return fftw_api<double>::export_wisdom(filename.c_str()) != 0;
+}
@@ -0,0 +1,195 @@
+#ifndef MYFFT
+#define MYFFT
+
+#include<cstdio>
+#include<string>
+#include<map>
+#include<tuple>
+
+#include<fftw3.h>
+
+using namespace std;
+
+/** Flags passed to the FFTW planner everywhere in the program.
+ * FFTW_MEASURE by default. Planning with FFTW_PATIENT is much slower, but
+ * the wisdom it produces is also good for later FFTW_MEASURE runs.
+ */
+extern unsigned int planner_flags;
+
+/** The kinds of plan kept in the shared registry */
+enum PlanKind { DFT_2D, R2C_2D, ROW_BLOCK, R2C_ROW_BLOCK, COLUMNS, ROW, R2C_ROW };
+
+/** Number of rows the pruned transform does at a time. Arrays can only be
+ * transformed that way if their number of rows is a multiple of it.
+ */
+#define PRUNE_BLOCK 8
+
+/** The parts of the FFTW API used here, for real numbers of type R.
+ * FFTW has a separate copy of its functions and types for each precision:
+ * fftw_... for double and fftwf_... for float, from a separate library.
+ * tag is the precision in the names of the wisdom files, "d" or "f".
+ */
+template <typename R> struct fftw_api;
+
+template <> struct fftw_api<double> {
+    using plan = fftw_plan;
+    using complex = fftw_complex;
+    static const char * tag() { return "d"; }
+
+    static plan plan_dft_2d(int nx, int ny, complex * in, complex * out, int sign, unsigned flags) {
+        return fftw_plan_dft_2d(nx, ny, in, out, sign, flags);
+    }
+    static plan plan_dft_r2c_2d(int nx, int ny, double * in, complex * out, unsigned flags) {
+        return fftw_plan_dft_r2c_2d(nx, ny, in, out, flags);
+    }
+    static plan plan_many_dft(int n, int howmany, complex * in, int istride, int idist, complex * out, int ostride, int odist, int sign, unsigned flags) {
+        return fftw_plan_many_dft(1, &n, howmany, in, NULL, istride, idist, out, NULL, ostride, odist, sign, flags);
+    }
+    static plan plan_many_dft_r2c(int n, int howmany, double * in, int idist, complex * out, int odist, unsigned flags) {
+        return fftw_plan_many_dft_r2c(1, &n, howmany, in, NULL, 1, idist, out, NULL, 1, odist, flags);
+    }
+    static void destroy_plan(plan p) { fftw_destroy_plan(p); }
+    static int import_wisdom(const char * filename) { return fftw_import_wisdom_from_filename(filename); }
+    static int export_wisdom(const char * filename) { return fftw_export_wisdom_to_filename(filename); }
+};
+
+template <> struct fftw_api<float> {
+    using plan = fftwf_plan;
+    using complex = fftwf_complex;
+    static const char * tag() { return "f"; }
+
+    static plan plan_dft_2d(int nx, int ny, complex * in, complex * out, int sign, unsigned flags) {
+        return fftwf_plan_dft_2d(nx, ny, in, out, sign, flags);
+    }
+    static plan plan_dft_r2c_2d(int nx, int ny, float * in, complex * out, unsigned flags) {
+        return fftwf_plan_dft_r2c_2d(nx, ny, in, out, flags);
+    }
+    static plan plan_many_dft(int n, int howmany, complex * in, int istride, int idist, complex * out, int ostride, int odist, int sign, unsigned flags) {
+        return fftwf_plan_many_dft(1, &n, howmany, in, NULL, istride, idist, out, NULL, ostride, odist, sign, flags);
+    }
+    static plan plan_many_dft_r2c(int n, int howmany, float * in, int idist, complex * out, int odist, unsigned flags) {
+        return fftwf_plan_many_dft_r2c(1, &n, howmany, in, NULL, 1, idist, out, NULL, 1, odist, flags);
+    }
+    static void destroy_plan(plan p) { fftwf_destroy_plan(p); }
+    static int import_wisdom(const char * filename) { return fftwf_import_wisdom_from_filename(filename); }
+    static int export_wisdom(const char * filename) { return fftwf_export_wisdom_to_filename(filename); }
+};
+
+/** Run a plan on other arrays, in either precision */
+inline void execute_dft(fftw_plan plan, fftw_complex * in, fftw_complex * out) { fftw_execute_dft(plan, in, out); }
+inline void execute_dft(fftwf_plan plan, fftwf_complex * in, fftwf_complex * out) { fftwf_execute_dft(plan, in, out); }
+inline void execute_dft_r2c(fftw_plan plan, double * in, fftw_complex * out) { fftw_execute_dft_r2c(plan, in, out); }
+inline void execute_dft_r2c(fftwf_plan plan, float * in, fftwf_complex * out) { fftwf_execute_dft_r2c(plan, in, out); }
+
+/**
+ * Get the plan for an nx by ny complex DFT with the given sign, in place if in == out.
+ * Each distinct plan is only made once, the first time it's asked for, and then
+ * shared by every thread. That first call plans on in and out, so their contents
+ * can be overwritten. Run the plan on your own arrays with execute_dft,
+ * which requires them to be allocated by fftw like the ones it was planned on.
+ * Every function here comes in double and single precision.
+ */
+fftw_plan shared_plan(int nx, int ny, int sign, fftw_complex * in, fftw_complex * out);
+fftwf_plan shared_plan(int nx, int ny, int sign, fftwf_complex * in, fftwf_complex * out);
+
+/**
+ * Same as shared_plan, for the forward transform of real nx by ny data in in,
+ * to the nx by (ny/2 + 1) non-redundant half of the spectrum in out.
+ * Run it with execute_dft_r2c.
+ */
+fftw_plan shared_plan_r2c(int nx, int ny, double * in, fftw_complex * out);
+fftwf_plan shared_plan_r2c(int nx, int ny, float * in, fftwf_complex * out);
+
+/** The two halves of a pruned 2D transform. row_plan transforms PRUNE_BLOCK rows
+ * of the input into the output, and col_plan transforms all the columns of the output in place.
+ */
+template <typename P>
+struct BasicPrunedPlan {
+    P row_plan, col_plan;
+};
+using PrunedPlan = BasicPrunedPlan<fftw_plan>;
+using PrunedPlanF = BasicPrunedPlan<fftwf_plan>;
+
+/** True if arrays with nx rows can be transformed with a pruned plan */
+bool can_prune(int nx);
+
+/**
+ * Get the shared pruned plan for a forward nx by ny DFT from in to out, in place
+ * if in == out, or, for the r2c version, from real data in to the nx by (ny/2 + 1)
+ * half spectrum. Same rules as shared_plan. Run them with execute_pruned.
+ */
+PrunedPlan shared_pruned_plan(int nx, int ny, fftw_complex * in, fftw_complex * out);
+PrunedPlanF shared_pruned_plan(int nx, int ny, fftwf_complex * in, fftwf_complex * out);
+PrunedPlan shared_pruned_plan_r2c(int nx, int ny, double * in, fftw_complex * out);
+PrunedPlanF shared_pruned_plan_r2c(int nx, int ny, float * in, fftwf_complex * out);
+
+/**
+ * Forward DFT of in into out, for when all the rows of in outside first_row to
+ * last_row (exclusive) are zero, like when a small aperture sits in a large array.
+ * The rows that are all zero transform to zero, so the row transforms are only
+ * done on the others, then the full column transforms. The result is the same
+ * (up to rounding) and has the same layout as with the full 2D plan.
+ */
+void execute_pruned(const PrunedPlan &plan, int nx, int ny, fftw_complex * in, fftw_complex * out, int first_row, int last_row);
+void execute_pruned(const PrunedPlanF &plan, int nx, int ny, fftwf_complex * in, fftwf_complex * out, int first_row, int last_row);
+void execute_pruned_r2c(const PrunedPlan &plan, int nx, int ny, double * in, fftw_complex * out, int first_row, int last_row);
+void execute_pruned_r2c(const PrunedPlanF &plan, int nx, int ny, float * in, fftwf_complex * out, int first_row, int last_row);
+
+/** An out-of-core 2D transform, for arrays too large for memory that are mapped from
+ * files (see BasicArray2d). Striding down the columns of those would read a page of
+ * the file for every element, so the transform is done in two passes that only read
+ * the file in long runs: row_plan transforms the rows one by one, then the columns
+ * are done tile_cols at a time: each tile is copied into a buffer in memory (the blocked
+ * transpose), its columns are transformed there with tile_plan (last_plan for the last
+ * tile, if it's narrower) and it's copied back.
+ */
+template <typename P>
+struct BasicTiledPlan {
+    P row_plan, tile_plan, last_plan;
+    int tile_cols;
+};
+using TiledPlan = BasicTiledPlan<fftw_plan>;
+using TiledPlanF = BasicTiledPlan<fftwf_plan>;
+
+/**
+ * Get the shared tiled plan for a forward nx by ny DFT from in to out (in place if
+ * in == out), or, for the r2c version, from real data in to the nx by (ny/2 + 1) half
+ * spectrum. The tiles are as wide as fit in tile_bytes of memory. Same rules as
+ * shared_plan. Run them with execute_tiled.
+ */
+TiledPlan shared_tiled_plan(int nx, int ny, fftw_complex * in, fftw_complex * out, size_t tile_bytes);
+TiledPlanF shared_tiled_plan(int nx, int ny, fftwf_complex * in, fftwf_complex * out, size_t tile_bytes);
+TiledPlan shared_tiled_plan_r2c(int nx, int ny, double * in, fftw_complex * out, size_t tile_bytes);
+TiledPlanF shared_tiled_plan_r2c(int nx, int ny, float * in, fftwf_complex * out, size_t tile_bytes);
+
+/**
+ * Forward DFT of in into out with a tiled plan. Like execute_pruned, only the rows
+ * from first_row to last_row (exclusive) are transformed, and the others must be zero;
+ * pass 0 and nx to transform all of them.
+ */
+void execute_tiled(const TiledPlan &plan, int nx, int ny, fftw_complex * in, fftw_complex * out, int first_row, int last_row);
+void execute_tiled(const TiledPlanF &plan, int nx, int ny, fftwf_complex * in, fftwf_complex * out, int first_row, int last_row);
+void execute_tiled_r2c(const TiledPlan &plan, int nx, int ny, double * in, fftw_complex * out, int first_row, int last_row);
+void execute_tiled_r2c(const TiledPlanF &plan, int nx, int ny, float * in, fftwf_complex * out, int first_row, int last_row);
+
+/** Destroy all the shared plans. Only call when no thread is using them any more */
+void destroy_shared_plans();
+
+/**
+ * Name of the wisdom file for a given transform size, set of directions
+ * and number of FFTW threads, in directory dir.
+ * Wisdom is only valid for the same precision, so that is part of the name too.
+ */
+string wisdom_filename(const string &dir, int nx, int ny, bool backward, int n_threads, bool single=false);
+
+/** Import the wisdom in filename, for single or double precision.
+ * Returns false if there was none to import
+ */
+bool load_wisdom(const string &filename, bool single=false);
+
+/** Export all the wisdom accumulated so far to filename, for single or double precision.
+ * Returns false if that failed
+ */
+bool save_wisdom(const string &filename, bool single=false);
+
+#endif
@@ -1,7 +1,17 @@
 #include "array2d.h"
+#include "fft.h"
+#include "rng.h"
+#include "trace.h"
+
+#include<list>
+#include<memory>
+#include<mutex>
+#include<tuple>
 
 #include<gsl/gsl_rng.h>
 #include<gsl/gsl_randist.h>
+#include<gsl/gsl_sf_bessel.h>
+#include<gsl/gsl_integration.h>
 
 #define INFO_OUT true
 #define DEBUG_OUT false
@@ -10,80 +20,144 @@
 Logger dbglog(stdout, "generator_dbg", DEBUG_OUT);
 Logger genlog(stdout, "generator", INFO_OUT);
 
+GeneratorSettings gen_settings = {false, 1, false};
+
+// philox streams, so the two random helpers give independent numbers for the same seed
+#define RAND_ERRORS_STREAM 0
+#define REAL_ERRORS_STREAM 1
+#define SPECTRAL_RE_STREAM 2
+#define SPECTRAL_IM_STREAM 3
+
+// the Hankel transforms of the radial apertures are done with this many Gauss-Legendre
+// points per panel, and panels as wide as a quarter of a period of J0 at the highest frequency
+#define RADIAL_GL_POINTS 8
+#define RADIAL_PANELS_PER_PERIOD 4
+#define RADIAL_MIN_PANELS 4
+
+/** Find the span of columns [begin, end) of a row for which inside(xs[j]) is true.
+ * inside must be true on one stretch of x around 0 and false further out, like
+ * being within some radius. xs must be increasing, as made by coords().
+ * Only the edges of the span are looked for, so this is O(log(n_cols)).
+ */
+template <typename P>
+void row_span(const vector<double>& xs, P inside, int &begin, int &end) {
+    vector<double>::const_iterator mid = lower_bound(xs.begin(), xs.end(), 0.0);
+    begin = partition_point(xs.begin(), mid, [&](double x) { return !inside(x); }) - xs.begin();
+    end = partition_point(mid, xs.end(), inside) - xs.begin();
+}
+
+/** Set the elements of a row of n elements to zero, except for the span [begin, end) */
+template <typename T>
+void zero_outside(T * row, int n, int begin, int end) {
+    fill(row, row + begin, T(0.0));
+    fill(row + max(begin, end), row + n, T(0.0));
+}
+
+// All the round apertures below are drawn one row at a time: first the span of
+// columns inside the outer radius (and the one inside the hole) is found, the
+// rest of the row is zeroed in one go, and the function is only evaluated inside.
+// So the time they take goes with the area of the aperture, not the array.
+
 /** Just a circle at the origin. Params[0] is the radius. */
-int circular(Array2d& in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
-    int nx = xs.size(), ny = ys.size();
-    double radius = params[0], r;
-
-    for(int i = 0; i < nx; i ++ ) {
-        for(int j = 0; j < ny; j ++ ) {
-            r = xs[j] * xs[j] + ys[i] * ys[i];
-            if(r <= radius*radius)
-                in[i][j] = 1.0;
-            else
-                in[i][j] = 0.0;
-        }
+template <typename A>
+int circular(A& in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
+    int n_cols = xs.size(), n_rows = ys.size();
+    double radius = params[0];
+    int begin, end;
+
+    for(int i = 0; i < n_rows; i ++ ) {
+        double ysq = ys[i] * ys[i];
+        row_span(xs, [&](double x) { return x * x + ysq <= radius*radius; }, begin, end);
+
+        zero_outside(in[i], n_cols, begin, end);
+        fill(in[i] + begin, in[i] + end, 1.0);
     }
     return 0;
 }
 
 /** A rectange of dimensions params[0] x params[1] */
-int rectangle(Array2d& in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
-    int nx = xs.size(), ny = ys.size();
+template <typename A>
+int rectangle(A& in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
+    int n_cols = xs.size(), n_rows = ys.size();
     double ax = params[0], ay = params[1];
 
-    for(int i = 0; i < nx; i ++ ) {
-        for(int j = 0; j < ny; j ++ ) {
-            if(abs(xs[j]) <= ax/2.0 && abs(ys[i]) <= ay/2.0)
-                in[i][j] = 1.0;
-            else
-                in[i][j] = 0.0;
+    // the columns are the same for all the rows that are inside
+    int begin, end;
+    row_span(xs, [&](double x) { return abs(x) <= ax/2.0; }, begin, end);
+
+    for(int i = 0; i < n_rows; i ++ ) {
+        if(abs(ys[i]) <= ay/2.0) {
+            zero_outside(in[i], n_cols, begin, end);
+            fill(in[i] + begin, in[i] + end, 1.0);
         }
+        else
+            zero_outside(in[i], n_cols, 0, 0);
     }
     return 0;
 }
 
 /** Gaussian illuminated circular aperture. params[0] is radius and params[1] is sigma */
-int gaussian(Array2d& in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
-    int nx = xs.size(), ny = ys.size();
+template <typename A>
+int gaussian(A& in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
+    int n_cols = xs.size(), n_rows = ys.size();
     double R = params[0], sig = params[1];
 
     double R_sq = R * R;
     double sigsq2 = 2.0 * sig * sig;
     double rsq;
+    int begin, end;
 
-    for(int i = 0; i < nx; i ++ ) {
-        for(int j = 0; j < ny; j ++ ) {
-            rsq = xs[j] * xs[j] + ys[i] * ys[i];
-            if(rsq <= R_sq)
-                in[i][j] = exp(-rsq / sigsq2);
-            else
-                in[i][j] = 0.0;
+    for(int i = 0; i < n_rows; i ++ ) {
+        double ysq = ys[i] * ys[i];
+        row_span(xs, [&](double x) { return x * x + ysq <= R_sq; }, begin, end);
+
+        zero_outside(in[i], n_cols, begin, end);
+        for(int j = begin; j < end; j ++ ) {
+            rsq = xs[j] * xs[j] + ysq;
+            in[i][j] = exp(-rsq / sigsq2);
         }
     }
     return 0;
 }
 
+/** Find the spans of a row that are inside the outer radius but not inside the hole:
+ * [begin, hole_begin) and [hole_end, end), either of which can be empty.
+ */
+void holed_row_spans(const vector<double>& xs, double ysq, double R_ext_sq, double R_int_sq, int &begin, int &hole_begin, int &hole_end, int &end) {
+    row_span(xs, [&](double x) { return x * x + ysq <= R_ext_sq; }, begin, end);
+    row_span(xs, [&](double x) { return x * x + ysq < R_int_sq; }, hole_begin, hole_end);
+
+    // keep both spans within the outer one, in case the hole is the bigger circle
+    hole_begin = max(begin, min(hole_begin, end));
+    hole_end = min(end, max(hole_end, hole_begin));
+}
+
 /** A circular Gaussian aperture with a hole in the middle 
  * params[0] is the radius. params[1] is sigma. params[2] is the hole radius.
  */
-int gaussian_hole(Array2d& in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
-    int nx = xs.size(), ny = ys.size();
+template <typename A>
+int gaussian_hole(A& in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
+    int n_cols = xs.size(), n_rows = ys.size();
     double R_ext = params[0], sig = params[1], R_int = params[2];
 
     double R_ext_sq = R_ext * R_ext;
     double R_int_sq = R_int * R_int;
     double sigsq2 = 2.0 * sig * sig;
     double rsq;
-
-    for(int i = 0; i < nx; i ++ ) {
-        for(int j = 0; j < ny; j ++ ) {
-            rsq = xs[j] * xs[j] + ys[i] * ys[i];
-            if(rsq <= R_ext_sq && rsq >= R_int_sq)
-                in[i][j] = exp(-rsq / sigsq2);
-            else
-                in[i][j] = 0.0;
-        }
+    int begin, hole_begin, hole_end, end;
+
+    for(int i = 0; i < n_rows; i ++ ) {
+        double ysq = ys[i] * ys[i];
+        holed_row_spans(xs, ysq, R_ext_sq, R_int_sq, begin, hole_begin, hole_end, end);
+
+        zero_outside(in[i], n_cols, begin, end);
+        fill(in[i] + hole_begin, in[i] + hole_end, 0.0);
+        auto put = [&](int j) {
+            rsq = xs[j] * xs[j] + ysq;
+            in[i][j] = exp(-rsq / sigsq2);
+        };
+        for(int j = begin; j < hole_begin; j ++ ) put(j);
+        for(int j = hole_end; j < end; j ++ ) put(j);
     }
     return 0;
 }
@@ -92,34 +166,47 @@ int gaussian_hole(Array2d& in, const vector<double>& xs, const vector<double>& y
  * params[0] is the outer radius. params[1] is sigma. params[2] is the inner(hole) radius.
  * params[3] is the sigma of the phase errors. params[4] is (optionally) the RNG seed.
  */
-int rand_errors(Array2d& in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
+template <typename R>
+int rand_errors(BasicArray2d<complex<R>>& in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
     // this is just unpacking the arguments
-    int nx = xs.size(), ny = ys.size();
+    int n_cols = xs.size(), n_rows = ys.size();
     double R_ext_sq = params[0] * params[0];
     double sig_sq2 = 2 * params[1] * params[1];
     double R_int_sq = params[2] * params[2];
     double err_sigma = params[3];
-    double rsq, phi;
-
-    // initiate a random number generator for the errors
-    gsl_rng * rng = gsl_rng_alloc(gsl_rng_default);
-    if(params.size() > 4) {
-        gsl_rng_set(rng, (unsigned long int)params[4]);
-    }
-
-    for(int i = 0; i < nx; i ++ ) {
-        for(int j = 0; j < ny; j ++ ) {
-            rsq = xs[j] * xs[j] + ys[i] * ys[i];
-            if(rsq <= R_ext_sq && rsq >= R_int_sq) {
-                phi = gsl_ran_gaussian(rng, err_sigma);
+    unsigned long seed = (params.size() > 4) ? (unsigned long)params[4] : 0;
+
+    // draw rows [row_begin, row_end), taking the phase errors (of deviation err_sigma) from gauss(i, j)
+    auto draw_rows = [&](int row_begin, int row_end, auto gauss) {
+        int begin, hole_begin, hole_end, end;
+        for(int i = row_begin; i < row_end; i ++ ) {
+            double ysq = ys[i] * ys[i];
+            holed_row_spans(xs, ysq, R_ext_sq, R_int_sq, begin, hole_begin, hole_end, end);
+
+            zero_outside(in[i], n_cols, begin, end);
+            fill(in[i] + hole_begin, in[i] + hole_end, 0.0);
+            auto put = [&](int j) {
+                double rsq = xs[j] * xs[j] + ysq;
+                double phi = gauss(i, j);
                 in[i][j] = polar(exp(-rsq / sig_sq2), phi);
-            }
-            else
-                in[i][j] = 0.0;
+            };
+            for(int j = begin; j < hole_begin; j ++ ) put(j);
+            for(int j = hole_end; j < end; j ++ ) put(j);
         }
-    }
+    };
 
-    gsl_rng_free(rng);
+    if(gen_settings.counter_rng) {
+        parallel_rows(n_rows, gen_settings.threads, [&](int row_begin, int row_end) {
+            draw_rows(row_begin, row_end, [&](int i, int j) { return err_sigma * philox_gaussian(seed, RAND_ERRORS_STREAM, i, j); });
+        });
+    }
+    else {
+        // the GSL numbers are drawn in the same (row-major) order as always
+        gsl_rng * rng = gsl_rng_alloc(gsl_rng_default);
+        if(params.size() > 4) gsl_rng_set(rng, seed);
+        draw_rows(0, n_rows, [&](int, int) { return gsl_ran_gaussian(rng, err_sigma); });
+        gsl_rng_free(rng);
+    }
     return 0;
 }
 
@@ -128,7 +215,8 @@ int rand_errors(Array2d& in, const vector<double>& xs, const vector<double>& ys,
  * params[0] is the correlation length.
  * Void return so it can't be exposed via the names map at the bottom.
  */
-void gauss_mask(Array2d &in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
+template <typename R>
+void gauss_mask(BasicArray2d<complex<R>> &in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
     // unpack arguments
     int n_cols = xs.size(), n_rows = ys.size();
     double lc = params[0];          // the correlation length
@@ -144,6 +232,91 @@ void gauss_mask(Array2d &in, const vector<double>& xs, const vector<double>& ys,
 }
 
 
+/** Helper: write the transfer function of the gaussian mask straight into spec,
+ * instead of transforming the mask: the DFT of a gaussian of correlation length lc,
+ * sampled with spacing dx, is sqrt(2 pi) lc / dx exp(-2 pi^2 lc^2 f^2), apart from
+ * aliasing and the cut at the edges of the array, which are negligible as long as
+ * dx << lc << the size of the array. The phase is that of a mask centred at index
+ * n/2, like gauss_mask's, unless modulated: then it's as if checkerboard was applied.
+ */
+template <typename R>
+void analytic_mask_spectrum(BasicArray2d<complex<R>> &spec, const vector<double>& xs, const vector<double>& ys, double lc, bool modulate) {
+    int n_cols = xs.size(), n_rows = ys.size();
+
+    // the 2D transfer function is the product of the two 1D ones
+    auto transfer = [&](const vector<double> &coord) {
+        int n = coord.size();
+        double d = coord[1] - coord[0];
+        vector<double> fs = fftfreq(n, d);
+        vector<complex<double>> g(n);
+        for(int k = 0; k < n; k ++ ) {
+            double amp = sqrt(2 * M_PI) * lc / d * exp(-2 * M_PI * M_PI * lc * lc * fs[k] * fs[k]);
+            g[k] = modulate ? amp : polar(amp, -2 * M_PI * k * (n/2) / n);
+        }
+        return g;
+    };
+    vector<complex<double>> gx = transfer(xs), gy = transfer(ys);
+
+    for(int i = 0; i < n_rows; i ++ )
+        for(int j = 0; j < n_cols; j ++ )
+            spec[i][j] = complex<R>(gy[i] * gx[j]);
+}
+
+
+// memory the cache of mask spectra may take up. The most recently used one is
+// always kept, even if it's larger than this.
+#define MASK_CACHE_BYTES (1ul << 30)
+
+/** Everything a mask spectrum depends on: lc, the ends of the grid along x and y and
+ * the sizes (which together fix the grid), whether it's modulated and whether it's analytic
+ */
+using MaskKey = tuple<double, double, double, double, double, int, int, bool, bool>;
+
+/** The spectra of the masks used recently, most recent first, one list per precision */
+template <typename R>
+list<pair<MaskKey, shared_ptr<const BasicArray2d<complex<R>>>>> mask_cache;
+static mutex mask_cache_mtx;
+
+template <typename R>
+shared_ptr<const BasicArray2d<complex<R>>> mask_spectrum(const vector<double>& xs, const vector<double>& ys, double lc, bool modulate, bool analytic) {
+    int n_cols = xs.size(), n_rows = ys.size();
+    MaskKey key(lc, xs.front(), xs.back(), ys.front(), ys.back(), n_rows, n_cols, modulate, analytic);
+
+    {
+        lock_guard<mutex> lock(mask_cache_mtx);
+        for(auto it = mask_cache<R>.begin(); it != mask_cache<R>.end(); it ++ )
+            if(it->first == key) {
+                mask_cache<R>.splice(mask_cache<R>.begin(), mask_cache<R>, it);
+                return it->second;
+            }
+    }
+
+    // not there, work it out without holding the lock. If another thread does the
+    // same one at the same time, the first one to finish goes in the cache
+    shared_ptr<BasicArray2d<complex<R>>> spec = make_shared<BasicArray2d<complex<R>>>(n_rows, n_cols);
+    if(analytic) {
+        analytic_mask_spectrum(*spec, xs, ys, lc, modulate);
+    }
+    else {
+        auto fwd_plan = shared_plan(n_rows, n_cols, FFTW_FORWARD, spec->ptr(), spec->ptr());
+        gauss_mask(*spec, xs, ys, {lc});
+        execute_dft(fwd_plan, spec->ptr(), spec->ptr());
+        if(modulate) checkerboard(*spec);
+    }
+
+    lock_guard<mutex> lock(mask_cache_mtx);
+    for(auto it = mask_cache<R>.begin(); it != mask_cache<R>.end(); it ++ )
+        if(it->first == key) return it->second;
+
+    mask_cache<R>.emplace_front(key, spec);
+    // evict the least recently used ones that don't fit. Workers still using them keep them alive
+    size_t entry_bytes = sizeof(complex<R>) * n_rows * n_cols;
+    while(mask_cache<R>.size() > 1 && entry_bytes * mask_cache<R>.size() > MASK_CACHE_BYTES)
+        mask_cache<R>.pop_back();
+    return spec;
+}
+
+
 /** Helper: round shape of radius params[0], filled with random real numbers.
  * The randomness is gaussian-distributed, with mean 0 and sigma given by params[1].
  * params[2] is the rng seed.
@@ -151,7 +324,8 @@ void gauss_mask(Array2d &in, const vector<double>& xs, const vector<double>& ys,
  * This is useful for convolving with the gaussian mask to produce correlated errors.
  * Also void return so it can't be included in the map.
  */
-void real_errors(Array2d &in, const vector<double> &xs, const vector<double> &ys, const vector<double> &params) {
+template <typename R>
+void real_errors(BasicArray2d<complex<R>> &in, const vector<double> &xs, const vector<double> &ys, const vector<double> &params) {
     // unpack the arguments
     int n_cols = xs.size(), n_rows = ys.size();
 
@@ -159,20 +333,70 @@ void real_errors(Array2d &in, const vector<double> &xs, const vector<double> &ys
     double err_sigma = params[1];
     unsigned long seed = (unsigned long)params[2];
 
-    double rsq;
-
-    // initialise the rng with the given seed
-    gsl_rng * rng = gsl_rng_alloc(gsl_rng_default);
-    gsl_rng_set(rng, seed);
+    // put a random number (of deviation err_sigma) at each point inside, and zeros everywhere else
+    auto draw_rows = [&](int row_begin, int row_end, auto gauss) {
+        int begin, end;
+        for(int i = row_begin; i < row_end; i ++ ) {
+            double ysq = ys[i] * ys[i];
+            row_span(xs, [&](double x) { return x * x + ysq <= R_ext_sq; }, begin, end);
 
-    // put a random number at each point
-    for(int i = 0; i < n_rows; i ++ )
-        for(int j = 0; j < n_cols; j ++ ) {
-            rsq = xs[j] * xs[j] + ys[i] * ys[i];
-            if(rsq <= R_ext_sq)
-                in[i][j] = gsl_ran_gaussian(rng, err_sigma);
+            zero_outside(in[i], n_cols, begin, end);
+            for(int j = begin; j < end; j ++ )
+                in[i][j] = gauss(i, j);
         }
-    gsl_rng_free(rng);
+    };
+
+    if(gen_settings.counter_rng) {
+        parallel_rows(n_rows, gen_settings.threads, [&](int row_begin, int row_end) {
+            draw_rows(row_begin, row_end, [&](int i, int j) { return err_sigma * philox_gaussian(seed, REAL_ERRORS_STREAM, i, j); });
+        });
+    }
+    else {
+        gsl_rng * rng = gsl_rng_alloc(gsl_rng_default);
+        gsl_rng_set(rng, seed);
+        draw_rows(0, n_rows, [&](int, int) { return gsl_ran_gaussian(rng, err_sigma); });
+        gsl_rng_free(rng);
+    }
+}
+
+
+/** Helper: turn the correlated depth in the real part of in into the aperture of
+ * corr_errors: the depth is scaled to RMS params[3] within the radius params[0], and
+ * set as the phase, with the gaussian taper of params[1] and the hole of params[2] as
+ * the amplitude.
+ */
+template <typename R>
+void depth_to_aperture(BasicArray2d<complex<R>> &in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
+    int n_cols = xs.size(), n_rows = ys.size();
+
+    double R_ext_sq = params[0] * params[0];
+    double sig_sq2 = 2 * params[1] * params[1];
+    double R_int_sq = params[2] * params[2];
+    double err_sigma = params[3];
+    double rsq, rho, phi;
+
+    // calculate the current RMS and normalize to get the desired RMS error
+    double depth_sigma = mean_stddev(myre, in, xs, ys, params[0]).err;    
+    in.mult_each(err_sigma / depth_sigma);
+
+    // walk the aperture and set the depth as the phase,
+    // and the amplitude as a gaussian taper
+    int begin, hole_begin, hole_end, end;
+    for(int i = 0; i < n_rows; i ++ ) {
+        double ysq = ys[i] * ys[i];
+        holed_row_spans(xs, ysq, R_ext_sq, R_int_sq, begin, hole_begin, hole_end, end);
+
+        zero_outside(in[i], n_cols, begin, end);
+        fill(in[i] + hole_begin, in[i] + hole_end, 0.0);
+        auto put = [&](int j) {
+            rsq = xs[j] * xs[j] + ysq;
+            phi = real(in(i, j));
+            rho = exp(- rsq / sig_sq2);
+            in[i][j] = polar(rho, phi);
+        };
+        for(int j = begin; j < hole_begin; j ++ ) put(j);
+        for(int j = hole_end; j < end; j ++ ) put(j);
+    }
 }
 
 
@@ -184,86 +408,183 @@ void real_errors(Array2d &in, const vector<double> &xs, const vector<double> &ys
  * 
  * params are the same as above for 0 -- 4, and params[5] is the correlation length.
  */
-int corr_errors(Array2d &in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
+template <typename R>
+int corr_errors(BasicArray2d<complex<R>> &in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
     // unpack the arguments
     int n_cols = xs.size(), n_rows = ys.size();
-
-    double R_ext_sq = params[0] * params[0];
-    double sig_sq2 = 2 * params[1] * params[1];
-    double R_int_sq = params[2] * params[2];
     double err_sigma = params[3];
     double seed = params[4];
     double lc = params[5];
 
-    double rsq, rho, phi;
+    // The mask is centred in the middle of the array, so the convolution comes out
+    // shifted by half the array. For even sizes, modulating the mask spectrum
+    // undoes that, otherwise the result is shifted to its proper place afterwards
+    bool modulate = (n_rows % 2 == 0 && n_cols % 2 == 0);
 
-    // declare the secondary array and fftw plans
-    static thread_local Array2d sec_array(n_rows, n_cols);
-    static thread_local fftw_plan fwd_plan, rev_plan, sec_plan;
-    static thread_local bool init = false;
-
-    // Planning: this only runs on the first call
-    if(!init) {
-        init = true;
-
-        planner_mtx.lock();
-        genlog("\t\tLocked. Planning convolution FFTs.");
-
-        // to check behaviour in multithreading, print array addresses
-        char buff[100];
-        sprintf(buff, "In array ptr: %p", (void*)in.ptr());
-        dbglog(buff);
-        sprintf(buff, "Sec array ptr: %p", (void*)sec_array.ptr());
-        dbglog(buff);
-
-        fwd_plan = fftw_plan_dft_2d(n_rows, n_cols, in.ptr(), in.ptr(), FFTW_FORWARD, FFTW_MEASURE);
-        rev_plan = fftw_plan_dft_2d(n_rows, n_cols, in.ptr(), in.ptr(), FFTW_BACKWARD, FFTW_MEASURE);
-        sec_plan = fftw_plan_dft_2d(n_rows, n_cols, sec_array.ptr(), sec_array.ptr(), FFTW_FORWARD, FFTW_MEASURE);
-        
-        planner_mtx.unlock();
-        genlog("\t\tUnlocked. Planning done.");
-    }
+    // the plans are shared with everyone else, and so is the mask spectrum,
+    // which is the same for every shape with this grid and correlation length
+    auto fwd_plan = traced("corr_plan", [&] { return shared_plan(n_rows, n_cols, FFTW_FORWARD, in.ptr(), in.ptr()); });
+    auto rev_plan = traced("corr_plan", [&] { return shared_plan(n_rows, n_cols, FFTW_BACKWARD, in.ptr(), in.ptr()); });
+    auto mask = traced("corr_mask", [&] { return mask_spectrum<R>(xs, ys, lc, modulate, gen_settings.analytic_mask); });
 
-    // init the arrays
     // note that real_errors writes real numbers to the array - the depth
-    gauss_mask(sec_array, xs, ys, {lc});
-    real_errors(in, xs, ys, {params[0] + 3*lc, err_sigma, seed});
+    traced("corr_depth", [&] { real_errors(in, xs, ys, {params[0] + 3*lc, err_sigma, seed}); });
+    traced("corr_fft", [&] { execute_dft(fwd_plan, in.ptr(), in.ptr()); });
 
-    // execute forward ffts
-    fftw_execute(fwd_plan);
-    fftw_execute(sec_plan);
+    // multiply and reverse FT
+    traced("corr_mult", [&] { in.mult(*mask); });
+    traced("corr_fft", [&] { execute_dft(rev_plan, in.ptr(), in.ptr()); });
+    if(!modulate) traced("corr_fftshift", [&] { fftshift(in); });
 
-    // multiply and reverse FT, then shift to proper place
-    in.mult(sec_array);
-    fftw_execute(rev_plan);
-    fftshift(in);
+    traced("corr_aperture", [&] { depth_to_aperture(in, xs, ys, params); });
+    return 0;
+}
 
-    // calculate the current RMS and normalize to get the desired RMS error
-    double depth_sigma = mean_stddev(myre, in, xs, ys, params[0]).err;    
-    in.mult_each(err_sigma / depth_sigma);
 
-    // walk the array and set the depth as the phase,
-    // and the amplitude as a gaussian taper
-    for(int i = 0; i < n_rows; i ++ )
-        for(int j = 0; j < n_cols; j ++ ) {
-            rsq = xs[j] * xs[j] + ys[i] * ys[i];
-            if(rsq <= R_ext_sq && rsq >= R_int_sq) {
-                phi = real(in(i, j));
-                rho = exp(- rsq / sig_sq2);
-                in[i][j] = polar(rho, phi);
-            }
-            else
-                in[i][j] = 0;
+/** Helper: element (i, j) of complex gaussian noise of unit variance with Hermitian
+ * symmetry, i.e. the element at the mirror image (mi, mj) = (-i, -j) is its conjugate.
+ * The pair is drawn from the counters of whichever of the two comes first in the array,
+ * so either can be asked for first, or on its own. Elements that are their own mirror
+ * image are real.
+ */
+complex<double> hermitian_noise(unsigned long seed, int i, int j, int mi, int mj) {
+    if(i == mi && j == mj)
+        return philox_gaussian(seed, SPECTRAL_RE_STREAM, i, j);
+
+    bool first = (i < mi || (i == mi && j < mj));
+    int ci = first ? i : mi, cj = first ? j : mj;
+    double re = philox_gaussian(seed, SPECTRAL_RE_STREAM, ci, cj) / M_SQRT2;
+    double im = philox_gaussian(seed, SPECTRAL_IM_STREAM, ci, cj) / M_SQRT2;
+    return complex<double>(re, first ? im : -im);
+}
+
+/** The same aperture as corr_errors, with statistically the same errors, but the depth
+ * is made straight in Fourier space: gaussian noise with Hermitian symmetry, shaped by
+ * the magnitude of the mask spectrum (the square root of the power spectrum of the depth),
+ * then transformed back once. Its transform is real, and, with the mask spectrum cached,
+ * this is one FFT instead of two, and needs no shift.
+ * The noise always comes from the philox generator, whatever rng is set to, because the
+ * two halves of the spectrum have to be drawn from the same numbers.
+ * params are the same as for corr_errors. The errors aren't cut to a disc before they're
+ * correlated, but that only makes a difference outside the aperture.
+ */
+template <typename R>
+int corr_errors_spectral(BasicArray2d<complex<R>> &in, const vector<double>& xs, const vector<double>& ys, const vector<double>& params) {
+    int n_cols = xs.size(), n_rows = ys.size();
+    unsigned long seed = (unsigned long)params[4];
+    double lc = params[5];
+
+    // share the mask spectrum with corr_errors
+    bool modulate = (n_rows % 2 == 0 && n_cols % 2 == 0);
+    auto rev_plan = shared_plan(n_rows, n_cols, FFTW_BACKWARD, in.ptr(), in.ptr());
+    auto mask = mask_spectrum<R>(xs, ys, lc, modulate, gen_settings.analytic_mask);
+
+    parallel_rows(n_rows, gen_settings.threads, [&](int row_begin, int row_end) {
+        for(int i = row_begin; i < row_end; i ++ ) {
+            int mi = (n_rows - i) % n_rows;
+            for(int j = 0; j < n_cols; j ++ )
+                in[i][j] = (double)abs((*mask)(i, j)) * hermitian_noise(seed, i, j, mi, (n_cols - j) % n_cols);
         }
+    });
+    execute_dft(rev_plan, in.ptr(), in.ptr());
 
+    depth_to_aperture(in, xs, ys, params);
     return 0;
 }
 
-map<string, aperture_generator> generators = {
-    {"circular", circular},
-    {"rectangle", rectangle},
-    {"gaussian", gaussian},
-    {"gaussian_hole", gaussian_hole},
-    {"rand_errors", rand_errors},
-    {"corr_errors", corr_errors}
-};
\ No newline at end of file
+// the real apertures are instantiated for both complex and real arrays, in both precisions
+map<string, Generator> generators = {
+    {"circular", {circular<Array2d>, circular<RealArray2d>}},
+    {"rectangle", {rectangle<Array2d>, rectangle<RealArray2d>}},
+    {"gaussian", {gaussian<Array2d>, gaussian<RealArray2d>}},
+    {"gaussian_hole", {gaussian_hole<Array2d>, gaussian_hole<RealArray2d>}},
+    {"rand_errors", {rand_errors<double>, NULL}},
+    {"corr_errors", {corr_errors<double>, NULL}},
+    {"corr_errors_spectral", {corr_errors_spectral<double>, NULL}}
+};
+
+map<string, BasicGenerator<float>> generators_f = {
+    {"circular", {circular<Array2df>, circular<RealArray2df>}},
+    {"rectangle", {rectangle<Array2df>, rectangle<RealArray2df>}},
+    {"gaussian", {gaussian<Array2df>, gaussian<RealArray2df>}},
+    {"gaussian_hole", {gaussian_hole<Array2df>, gaussian_hole<RealArray2df>}},
+    {"rand_errors", {rand_errors<float>, NULL}},
+    {"corr_errors", {corr_errors<float>, NULL}},
+    {"corr_errors_spectral", {corr_errors_spectral<float>, NULL}}
+};
+
+// The same round apertures along the radius, for the Hankel transform. They have the same
+// edges as the ones on the grid: the hole is r < R_int, and the outside r > R
+void disc_support(const vector<double>& params, double &r_min, double &r_max) {
+    r_min = 0.0;
+    r_max = params[0];
+}
+
+void ring_support(const vector<double>& params, double &r_min, double &r_max) {
+    r_min = params[2];
+    r_max = params[0];
+}
+
+double circular_radial(double r, const vector<double>& params) {
+    return 1.0;
+}
+
+double gaussian_radial(double r, const vector<double>& params) {
+    double sig = params[1];
+    return exp(-r * r / (2.0 * sig * sig));
+}
+
+map<string, RadialGenerator> radial_generators = {
+    {"circular", {disc_support, circular_radial}},
+    {"gaussian", {disc_support, gaussian_radial}},
+    {"gaussian_hole", {ring_support, gaussian_radial}}
+};
+
+void radial_image(const RadialGenerator &gen, const vector<double> &params, const vector<double> &ps, int first, int last, double scale, vector<double> &image) {
+    if((int)image.size() < last) image.resize(last);
+
+    double r_min, r_max;
+    gen.support(params, r_min, r_max);
+    if(r_max <= r_min) {
+        fill(image.begin() + first, image.begin() + last, 0.0);
+        return;
+    }
+
+    // J0(p r) goes through a period every 2 pi / p along r, so the panels are made
+    // narrow enough for the highest frequency. The support's edges are on panel edges,
+    // so the jumps of the aperture don't fall inside a panel
+    double p_max = 0.0;
+    for(int l = first; l < last; l ++ )
+        p_max = max(p_max, abs(ps[l]));
+    int n_panels = max(RADIAL_MIN_PANELS, (int)ceil((r_max - r_min) * p_max * RADIAL_PANELS_PER_PERIOD / (2 * M_PI)));
+    double width = (r_max - r_min) / n_panels;
+
+    // the points r and their weights times a(r) r, which are the same for all p
+    gsl_integration_glfixed_table * table = gsl_integration_glfixed_table_alloc(RADIAL_GL_POINTS);
+    vector<double> rs, ws;
+    for(int k = 0; k < n_panels; k ++ ) {
+        double a = r_min + k * width, b = (k == n_panels - 1) ? r_max : a + width;
+        for(int i = 0; i < RADIAL_GL_POINTS; i ++ ) {
+            double r, w;
+            gsl_integration_glfixed_point(a, b, i, &r, &w, table);
+            rs.push_back(r);
+            ws.push_back(w * gen.amplitude(r, params) * r);
+        }
+    }
+    gsl_integration_glfixed_table_free(table);
+
+    for(int l = first; l < last; l ++ ) {
+        double sum = 0.0;
+        for(unsigned int k = 0; k < rs.size(); k ++ )
+            sum += ws[k] * gsl_sf_bessel_J0(ps[l] * rs[k]);
+        image[l] = 2 * M_PI * scale * sum;
+    }
+}
+
+template <>
+const map<string, Generator>& generators_for<double>() { return generators; }
+template <>
+const map<string, BasicGenerator<float>>& generators_for<float>() { return generators_f; }
+
+template shared_ptr<const Array2d> mask_spectrum(const vector<double>& xs, const vector<double>& ys, double lc, bool modulate, bool analytic);
+template shared_ptr<const Array2df> mask_spectrum(const vector<double>& xs, const vector<double>& ys, double lc, bool modulate, bool analytic);
@@ -1,14 +1,19 @@
 #include<cstdio>
 #include<cmath>
 #include<complex>
-#include<queue>
 #include<thread>
+#include<memory>
 
 #include<gsl/gsl_sf_trig.h>
 #include<gsl/gsl_math.h>
 #include<fftw3.h>
 
+#include "analysis.h"
 #include "array2d.h"
+#include "fft.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "writer.h"
 #include "util.h"
 
 using namespace std;
@@ -18,168 +23,564 @@ using namespace std;
 
 #define INFO_OUT true
 
-/** This block defines a struct that has an index and a string;
- * It's meant to hold a line of data to be printed to the data file.
- * The comparator is used to sort data lines by the index in the priority queue, so that
- * if we use multiple workers, the data lines are still printed in order when
- * main() does the dequeueing.
+// where FFTW wisdom is kept between runs, relative to the working directory
+#define WISDOM_DIR "wisdom"
+
+/** Print fun of the array a within lims to the file for shape_idx with the given suffix,
+ * in the format asked for by the config
+ */
+template <typename P, typename T>
+void print_array(const Config& conf, unsigned int shape_idx, const char * suffix, P fun, const BasicArray2d<T> &a, const vector<double> &xs, const vector<double> &ys, const Limits &lims) {
+    TraceSpan span("print");
+    string fname = conf.out_prefix + to_string(shape_idx) + suffix;
+
+    if(conf.print_format == "txt") {
+        FILE * filep = fopen((fname + ".txt").c_str(), "w");
+        print_lim_array(filep, fun, a, xs, ys, lims);
+        fclose(filep);
+    }
+    else {
+        bool dbl = (conf.print_format == "npy64");
+        save_lim_array_npy(fname + ".npy", fname + "_lims.txt", fun, a, xs, ys, lims, dbl);
+    }
+}
+
+/** The arrays one worker needs, in precision R. Each one is only allocated the first
+ * time it's asked for, so e.g. a worker that only gets real apertures never allocates
+ * the full size complex ones. If scratch_dir isn't empty, they're mapped from files there.
  */
-struct DataLine{
-    unsigned int idx;
-    string line;
+template <typename R>
+class WorkerArrays {
+private:
+    using CArray = BasicArray2d<complex<R>>;
+    int nx, ny;
+    string scratch_dir;
+    unique_ptr<CArray> in_arr, out_arr, half_arr, zoom_arr;
+    unique_ptr<BasicArray2d<R>> real_in_arr;
+
+    template <typename A>
+    A * make(int rows, int cols) {
+        return scratch_dir.empty() ? new A(rows, cols) : new A(rows, cols, scratch_dir);
+    }
+
+public:
+    WorkerArrays(int nx, int ny, const string &scratch_dir) : nx(nx), ny(ny), scratch_dir(scratch_dir) {}
+
+    /** complex input, nx x ny, which is transformed in place */
+    CArray& in() {
+        if(!in_arr) in_arr.reset(make<CArray>(nx, ny));
+        return *in_arr;
+    }
+    /** complex output, nx x ny. Only needed to expand the half spectrum of a real aperture */
+    CArray& out() {
+        if(!out_arr) out_arr.reset(make<CArray>(nx, ny));
+        return *out_arr;
+    }
+    /** real input, nx x ny, and the half of its spectrum that isn't redundant */
+    BasicArray2d<R>& real_in() {
+        if(!real_in_arr) real_in_arr.reset(make<BasicArray2d<R>>(nx, ny));
+        return *real_in_arr;
+    }
+    CArray& half_out() {
+        if(!half_arr) half_arr.reset(make<CArray>(nx, ny/2 + 1));
+        return *half_arr;
+    }
+    /** the image in the zoom window, which is small enough to always be in memory */
+    CArray& zoom_out(int rows, int cols) {
+        if(!zoom_arr) zoom_arr.reset(new CArray(rows, cols));
+        return *zoom_arr;
+    }
 };
 
-auto dlcmp = [](DataLine a, DataLine b) { return a.idx > b.idx; };
-priority_queue<DataLine, vector<DataLine>, decltype(dlcmp)> dataq(dlcmp);
 
+/** Fill in the (unshifted) angular frequencies of the image of shape sp along its rows, ps,
+ * and its columns, qs, and return its number of columns.
+ * With a zoom window, the image is 2 * zoom_points square, and laid out like an FFT:
+ * from the centre out, with the negative frequencies in the second half.
+ */
+int image_freqs(const Config& conf, const ShapeProperties& sp, vector<double>& ps, vector<double>& qs) {
+    if(conf.zoom_window > 0.0) {
+        int n = 2 * conf.zoom_points;
+        double spacing = conf.zoom_window / conf.zoom_points;
+        ps = fftfreq(n, 1.0 / (n * spacing));
+        qs = ps;
+        return n;
+    }
+    // the division by 2pi is because p and q are angular frequencies,
+    // whereas the FFT produces number frequencies
+    ps = fftfreq(conf.nx, sp.lx/(double)conf.nx/(2*M_PI));
+    qs = fftfreq(conf.ny, sp.ly/(double)conf.ny/(2*M_PI));
+    return conf.ny;
+}
+
+
+/** Do the configured tasks on the aperture `in` of one shape, before it's transformed,
+ * so that it can be transformed in place: the engine's sweep over it, whose results go
+ * in res, and printing it.
+ */
+template <typename InArray>
+void resolve_in_tasks(const Config& conf, const AnalysisEngine& engine, unsigned int shape_idx, const ShapeProperties& sp, const InArray& in, ShapeResults& res, const Logger& proc_log) {
+    vector<double> xs = coords(sp.lx, conf.nx);
+    vector<double> ys = coords(sp.ly, conf.ny);
+
+    proc_log("Resolving input tasks:");
+    proc_log("\t sweeping in");
+    traced("sweep_in", [&] { engine.analyse_in(in, xs, ys, sp.shape_params[0], res); });
+
+    if(contains(conf.tasks, "print_in_abs")) {
+        proc_log("\tprint_in_abs");
+        // print aperture amplitude
+        print_array(conf, shape_idx, "in_abs", myabs, in, xs, ys, res.in_lims);
+    }
+    if(contains(conf.tasks, "print_in_phase")) {
+        proc_log("\tprint_in_phase");
+        // print aperture phase
+        print_array(conf, shape_idx, "in_phase", myarg, in, xs, ys, res.in_lims);
+    }
+}
+
+
+/** Add the results in res of the data tasks up to in_phase_stat to dl, in the order of the data file */
+void add_data_fields(const Config& conf, const ShapeProperties& sp, const ShapeResults& res, DataLine& dl) {
+    if(contains(conf.tasks, "params")) {
+        // print shape parameters
+        for(unsigned int ip = 0; ip < sp.shape_params.size(); ip ++ )
+            dl.line += "\t" + to_string(sp.shape_params[ip]);
+    }
+    if(contains(conf.tasks, "find_min")) {
+        // print size of central spot and error
+        dl.line += "\t" + to_string(res.first_min.val) + "\t" + to_string(res.first_min.err);
+    }
+    if(contains(conf.tasks, "fwhp")) {
+        // print coordinate of full-width at half-power along horizontal.
+        // times by 2 for FULL width (function gives half width)
+        dl.line += "\t" + to_string(res.fwhp.val * 2) + "\t" + to_string(res.fwhp.err * 2);
+    }
+    if(contains(conf.tasks, "fwhp_y")) {
+        // print coordinate of FWHP along vertical
+        dl.line += "\t" + to_string(res.fwhp_y.val * 2) + "\t" + to_string(res.fwhp_y.err * 2);
+    }
+    if(contains(conf.tasks, "central_amplitude")) {
+        // print absolute value of central spot
+        dl.line += "\t" + to_string(res.central_amplitude);
+    }
+    if(contains(conf.tasks, "in_phase_stat")) {
+        // print the mean and RMS of phase errors in input array
+        dl.line += "\t" + to_string(res.in_phase.val) + "\t" + to_string(res.in_phase.err);
+    }
+}
+
+
+/** Do the rest of the configured tasks on one shape, given its transform `out`, and add
+ * the results of all the data tasks, with those of resolve_in_tasks in res, to dl.
+ * For real apertures, out only holds the first ny/2 + 1 columns of the transform; the rest
+ * is reconstructed into arrays.out() if the image is printed.
+ * The data tasks are done by the engine in one sweep over each array; Array printing is handled here;
+ */
+template <typename R>
+void resolve_out_tasks(const Config& conf, const AnalysisEngine& engine, unsigned int shape_idx, const ShapeProperties& sp, BasicArray2d<complex<R>>& out, WorkerArrays<R>& arrays, ShapeResults& res, DataLine& dl, const Logger& proc_log) {
+    // calculate p and q values for out
+    vector<double> ps, qs;
+    int n_cols = image_freqs(conf, sp, ps, qs);
+
+    proc_log("Resolving output tasks:");
+    proc_log("\t sweeping out");
+    traced("sweep_out", [&] { engine.analyse_out(out, n_cols, ps, qs, res); });
+
+    // the limits are for the shifted image
+    ps = fftshift(ps); qs = fftshift(qs);
+
+    add_data_fields(conf, sp, res, dl);
+    if(contains(conf.tasks, "out_lims")) {
+        // record the boundaries of the image that are above the given sensitivity
+        // reminder: lims = {imin, imax, jmin, jmax}
+        int imin = res.out_lims[0], imax = res.out_lims[1];
+        int jmin = res.out_lims[2], jmax = res.out_lims[3];
+        double p1 = ps[jmin], p2 = ps[jmax - 1];
+        double q1 = qs[imin], q2 = qs[imax - 1];
+
+        dl.line += "\t" + to_string(p1) + "\t" + to_string(p2);
+        dl.line += "\t" + to_string(q1) + "\t" + to_string(q2);
+    }
+
+    // only the printing needs the whole, shifted image. That's out itself, unless it's
+    // only half; then the full nx x ny arrays.out() is made for it the first time, so it
+    // must not be asked for before this return, or every real aperture would pay for it
+    if(!any_begins_with(conf.tasks, "print_out")) return;
+
+    BasicArray2d<complex<R>>& image = (out.cols() == n_cols) ? out : arrays.out();
+    if(&out != &image) {
+        proc_log("\texpand_hermitian(out)");
+        traced("expand_hermitian", [&] { expand_hermitian(out, image); });
+    }
+    // this screws up out
+    proc_log("\tfftshift(out)");
+    traced("fftshift", [&] { fftshift(image); });
+
+    if(contains(conf.tasks, "print_out_abs")) {
+        proc_log("\tprint_out_abs");
+        // print image amplitude
+        print_array(conf, shape_idx, "out_abs", myabs, image, ps, qs, res.out_lims);
+    }
+    if(contains(conf.tasks, "print_out_phase")) {
+        proc_log("\tprint_out_phase");
+        // print image phase
+        print_array(conf, shape_idx, "out_phase", myarg, image, ps, qs, res.out_lims);
+    }
+}
+
+
+/** Do the data tasks of engine on a radially symmetric shape from the Hankel transform of
+ * its aperture along the radius, instead of the FFT, into res. That only needs the image
+ * along the axes, out to the first minimum and half power points, so it's a lot faster.
+ */
+void radial_tasks(const Config& conf, const AnalysisEngine& engine, const ShapeProperties& sp, ShapeResults& res) {
+    vector<double> ps, qs;
+    image_freqs(conf, sp, ps, qs);
+    // in the same units as the FFT of the aperture on the grid, i.e. divided by its spacings
+    double scale = conf.nx * conf.ny / (sp.lx * sp.ly);
+    TraceSpan span("hankel");
+    engine.analyse_radial(radial_generators.at(sp.generator_key), sp.shape_params, scale, ps, qs, res);
+}
+
+
+/** The tasks that are done in both precisions with precision = compare */
+#define PRECISION_TASKS {"find_min", "fwhp", "fwhp_y", "central_amplitude"}
+
+/** The tasks that are checked against the analytic results with estimate = validate */
+#define VALIDATION_TASKS {"find_min", "fwhp", "fwhp_y"}
+
+/** Do the tasks of engine on the transform out of the shape sp, for the reports of
+ * precision = compare and estimate = validate
+ */
+template <typename T>
+void report_tasks(const Config& conf, const AnalysisEngine& engine, const ShapeProperties& sp, const BasicArray2d<T>& out, ShapeResults& res) {
+    vector<double> ps, qs;
+    int n_cols = image_freqs(conf, sp, ps, qs);
+    engine.analyse_out(out, n_cols, ps, qs, res);
+}
+
+/** The line of the precision report for one shape: for each of the PRECISION_TASKS,
+ * the result in double precision, in single precision, and their relative difference
+ */
+DataLine precision_line(unsigned int shape_idx, const ShapeResults& dbl, const ShapeResults& sgl) {
+    DataLine dl{shape_idx, to_string(shape_idx)};
+    auto add = [&](double d, double s) {
+        char buff[100];
+        double rel = (d == s) ? 0.0 : abs(s - d) / max(abs(d), abs(s));
+        sprintf(buff, "\t%.9g\t%.9g\t%.3g", d, s, rel);
+        dl.line += buff;
+    };
+    // full widths, like in the data file
+    add(dbl.first_min.val, sgl.first_min.val);
+    add(dbl.fwhp.val * 2, sgl.fwhp.val * 2);
+    add(dbl.fwhp_y.val * 2, sgl.fwhp_y.val * 2);
+    add(dbl.central_amplitude, sgl.central_amplitude);
+    return dl;
+}
+
+
+/** The line of the validation report for one shape: for each of the VALIDATION_TASKS,
+ * the analytic result, then the grid point and its error, then the interpolated point and
+ * its error. The widths are full widths, like in the data file. The analytic results are nan
+ * for the apertures that don't have them.
+ */
+DataLine validation_line(unsigned int shape_idx, const ShapeProperties& sp, const ShapeResults& grid, const ShapeResults& interp) {
+    DataLine dl{shape_idx, to_string(shape_idx)};
+    ShapeResults exact;
+    if(!analytic_results(sp, exact))
+        exact.first_min.val = exact.fwhp.val = exact.fwhp_y.val = NAN;
+
+    auto add = [&](double scale, const ValueError<double>& e, const ValueError<double>& g, const ValueError<double>& i) {
+        char buff[200];
+        sprintf(buff, "\t%.9g\t%.9g\t%.3g\t%.9g\t%.3g", e.val * scale, g.val * scale, g.err * scale, i.val * scale, i.err * scale);
+        dl.line += buff;
+    };
+    add(1, exact.first_min, grid.first_min, interp.first_min);
+    add(2, exact.fwhp, grid.fwhp, interp.fwhp);
+    add(2, exact.fwhp_y, grid.fwhp_y, interp.fwhp_y);
+    return dl;
+}
+
+
+/** Draw the aperture of shape sp into the arrays of precision R and call in_done(in) with
+ * it, then transform it and call out_done(out) with its transform.
+ * Complex apertures are transformed in place, since nothing needs them after in_done,
+ * so out is the same array as in, and only one full size complex array is allocated.
+ * Real ones go to the half spectrum, which together with them takes the same memory.
+ * With storage = mmap, the arrays are in files and the transforms are tiled.
+ * With a zoom window, out is the image in the window, straight from the aperture.
+ */
+template <typename R, typename FIn, typename FOut>
+void process_shape(const Config& conf, bool pruned, WorkerArrays<R>& arrays, const ShapeProperties& sp, const Logger& proc_log, FIn in_done, FOut out_done) {
+    BasicGenerator<R> gen = generators_for<R>().at(sp.generator_key);
+
+    vector<double> xs = coords(sp.lx, conf.nx);
+    vector<double> ys = coords(sp.ly, conf.ny);
+
+    bool tiled = (conf.storage == "mmap");
+    size_t tile_bytes = (size_t)conf.tile_mb << 20;
+    // the rows to transform with pruned or tiled transforms
+    int first_row = 0, last_row = conf.nx;
+
+    if(conf.zoom_window > 0.0) {
+        vector<double> ps, qs;
+        image_freqs(conf, sp, ps, qs);
+        BasicArray2d<complex<R>>& out = arrays.zoom_out(qs.size(), ps.size());
+        // the spacings that make the frequencies the same as those of the FFT
+        double dx = sp.lx / conf.ny, dy = sp.ly / conf.nx;
+
+        if(gen.real_gen != NULL) {
+            BasicArray2d<R>& in = arrays.real_in();
+            proc_log("Initializing real input...");
+            traced("generate", [&] { gen.real_gen(in, xs, ys, sp.shape_params); });
+            in_done(in);
+            proc_log("Executing zoom...");
+            traced("zoom", [&] { zoom_dft(in, dx, dy, ps, qs, out); });
+        }
+        else {
+            BasicArray2d<complex<R>>& in = arrays.in();
+            proc_log("Initializing input...");
+            traced("generate", [&] { gen.gen(in, xs, ys, sp.shape_params); });
+            in_done(in);
+            proc_log("Executing zoom...");
+            traced("zoom", [&] { zoom_dft(in, dx, dy, ps, qs, out); });
+        }
+        out_done(out);
+        return;
+    }
+
+    // plans are shared by all workers; only the first one to ask for each actually plans,
+    // which can overwrite the arrays, so always get the plans before filling in the input.
+    // Real apertures only need a real-to-complex transform
+    if(gen.real_gen != NULL) {
+        BasicArray2d<R>& in = arrays.real_in();
+        BasicArray2d<complex<R>>& out = arrays.half_out();
+
+        if(tiled) {
+            auto plan = traced("plan", [&] { return shared_tiled_plan_r2c(conf.nx, conf.ny, in.ptr(), out.ptr(), tile_bytes); });
+
+            proc_log("Initializing real input...");
+            traced("generate", [&] { gen.real_gen(in, xs, ys, sp.shape_params); });
+            in_done(in);
+
+            proc_log("Executing tiled r2c...");
+            if(pruned) nonzero_rows(in, first_row, last_row);
+            traced("fft", [&] { execute_tiled_r2c(plan, conf.nx, conf.ny, in.ptr(), out.ptr(), first_row, last_row); });
+        }
+        else if(pruned) {
+            auto plan = traced("plan", [&] { return shared_pruned_plan_r2c(conf.nx, conf.ny, in.ptr(), out.ptr()); });
+
+            proc_log("Initializing real input...");
+            traced("generate", [&] { gen.real_gen(in, xs, ys, sp.shape_params); });
+            in_done(in);
+
+            proc_log("Executing pruned r2c...");
+            nonzero_rows(in, first_row, last_row);
+            traced("fft", [&] { execute_pruned_r2c(plan, conf.nx, conf.ny, in.ptr(), out.ptr(), first_row, last_row); });
+        }
+        else {
+            auto plan = traced("plan", [&] { return shared_plan_r2c(conf.nx, conf.ny, in.ptr(), out.ptr()); });
+
+            proc_log("Initializing real input...");
+            traced("generate", [&] { gen.real_gen(in, xs, ys, sp.shape_params); });
+            in_done(in);
+
+            proc_log("Executing r2c...");
+            traced("fft", [&] { execute_dft_r2c(plan, in.ptr(), out.ptr()); });
+        }
+        out_done(out);
+    }
+    else {
+        BasicArray2d<complex<R>>& in = arrays.in();
+
+        if(tiled) {
+            auto plan = traced("plan", [&] { return shared_tiled_plan(conf.nx, conf.ny, in.ptr(), in.ptr(), tile_bytes); });
+
+            proc_log("Initializing input...");
+            traced("generate", [&] { gen.gen(in, xs, ys, sp.shape_params); });
+            in_done(in);
 
-/** Process the shapes between start and end (inclusive, exclusive) in the config.
+            proc_log("Executing tiled in place...");
+            if(pruned) nonzero_rows(in, first_row, last_row);
+            traced("fft", [&] { execute_tiled(plan, conf.nx, conf.ny, in.ptr(), in.ptr(), first_row, last_row); });
+        }
+        else if(pruned) {
+            auto plan = traced("plan", [&] { return shared_pruned_plan(conf.nx, conf.ny, in.ptr(), in.ptr()); });
+
+            proc_log("Initializing input...");
+            traced("generate", [&] { gen.gen(in, xs, ys, sp.shape_params); });
+            in_done(in);
+
+            proc_log("Executing pruned in place...");
+            nonzero_rows(in, first_row, last_row);
+            traced("fft", [&] { execute_pruned(plan, conf.nx, conf.ny, in.ptr(), in.ptr(), first_row, last_row); });
+        }
+        else {
+            auto plan = traced("plan", [&] { return shared_plan(conf.nx, conf.ny, FFTW_FORWARD, in.ptr(), in.ptr()); });
+
+            // fill in the input
+            proc_log("Initializing input...");
+            traced("generate", [&] { gen.gen(in, xs, ys, sp.shape_params); });
+            in_done(in);
+
+            proc_log("Executing in place...");
+            traced("fft", [&] { execute_dft(plan, in.ptr(), in.ptr()); });
+        }
+        out_done(in);
+    }
+}
+
+
+/** Process shapes from the config, as handed out by the scheduler, until there are none left.
  * n_proc is the processor number, used in the logger name for debugging
- * Push the data results to the data queue; Array printing is handled here;
+ * Push the data results to the writer, and with precision = compare, the
+ * precision report lines to precision_writer, and with estimate = validate, the
+ * validation report lines to validation_writer; and record them in the journal
+ * once the shape is done.
  */
-void shapes_worker(const Config& conf, unsigned int n_proc, unsigned int start, unsigned int end) {
+void shapes_worker(const Config& conf, unsigned int n_proc, ShapeScheduler& sched, OrderedWriter& writer, OrderedWriter* precision_writer, OrderedWriter* validation_writer, Journal& journal) {
     // init a logger for each processor
     string logname = "work_" + to_string(n_proc);
     Logger proc_log(stdout, logname.c_str(), INFO_OUT);
 
-    proc_log("Started on shapes " + to_string(start) + " to " + to_string(end));
-
-    // declarations
-    Array2d in(conf.nx, conf.ny);
-    Array2d out(conf.nx, conf.ny);
-    fftw_plan plan;
-
-    // plan
-    planner_mtx.lock();
-    proc_log("Locked. Planning...");
-    plan = fftw_plan_dft_2d(conf.nx, conf.ny, in.ptr(), out.ptr(), FFTW_FORWARD, FFTW_MEASURE);
-    planner_mtx.unlock();
-    proc_log("Unlocked. Planning done.");
+    proc_log("Started");
+
+    // declarations. The arrays of the precision that isn't used are never allocated
+    string scratch_dir = (conf.storage == "mmap") ? conf.scratch_dir : "";
+    WorkerArrays<double> arrays(conf.nx, conf.ny, scratch_dir);
+    WorkerArrays<float> arrays_f(conf.nx, conf.ny, scratch_dir);
+    AnalysisEngine engine(conf);
+    AnalysisEngine precision_engine(PRECISION_TASKS, 0.0, 0.0, conf.estimate != "grid");
+    AnalysisEngine grid_engine(VALIDATION_TASKS, 0.0, 0.0, false);
+    AnalysisEngine interp_engine(VALIDATION_TASKS, 0.0, 0.0, true);
+    bool compare = (conf.precision == "compare");
+    bool validate = (conf.estimate == "validate");
+    // with radial = auto, the round apertures skip the FFT if the tasks allow it
+    bool radial = (conf.radial == "auto") && engine.radial_only() && !compare;
+
+    // only transform the rows that aren't all zero, if asked to and the size allows it
+    bool pruned = (conf.fft_mode == "pruned");
+    if(pruned && !can_prune(conf.nx)) {
+        proc_log("nx is not a multiple of " + to_string(PRUNE_BLOCK) + ". Can't prune, doing full transforms.");
+        pruned = false;
+    }
 
-    for(unsigned int shape_idx = start; shape_idx < end; shape_idx ++ ) {
+    unsigned int shape_idx;
+    while(sched.next(shape_idx)) {
         proc_log("===== Shape " + to_string(shape_idx) + " =====");
+        trace_context(n_proc, shape_idx);
+        TraceSpan shape_span("shape");
         ShapeProperties sp = conf.shapes[shape_idx];
 
         // construct new data line
         DataLine dl{shape_idx, to_string(shape_idx)};
 
-        // calculate x and y values for both in and out
-        // the division by 2pi is because p and q are angular frequencies,
-        // whereas the FFT produces number frequencies
-        vector<double> xs = coords(sp.lx, conf.nx);
-        vector<double> ys = coords(sp.ly, conf.ny);
-        vector<double> ps = fftfreq(conf.nx, sp.lx/(double)conf.nx/(2*M_PI));
-        vector<double> qs = fftfreq(conf.ny, sp.ly/(double)conf.ny/(2*M_PI));
-        // the printing boundaries of the arrays
-        Limits in_lims, out_lims;
-
-        // fill in the input
-        proc_log("Initializing input...");
-        generators[sp.generator_key](in, xs, ys, sp.shape_params);
-
-        proc_log("Executing...");
-        fftw_execute(plan);
-
-        proc_log("Resolving tasks:");
-        if(contains(conf.tasks, "params")) {
-            // print shape parameters
-            for(unsigned int ip = 0; ip < sp.shape_params.size(); ip ++ )
-                dl.line += "\t" + to_string(sp.shape_params[ip]);
-        }
-        if(contains(conf.tasks, "find_min")) {
-            // print size of central spot and error
-            ValueError<double> min_pos = find_first_min(myabs, out, ps);
-            dl.line += "\t" + to_string(min_pos.val) + "\t" + to_string(min_pos.err);
-        }
-        if(contains(conf.tasks, "fwhp")) {
-            // print coordinate of full-width at half-power along horizontal.
-            // times by 2 for FULL width (function gives half width)
-            ValueError<double> res = hwhp(out, ps);
-            dl.line += "\t" + to_string(res.val * 2) + "\t" + to_string(res.err * 2);
-        }
-        if(contains(conf.tasks, "fwhp_y")) {
-            // print coordinate of FWHP along vertical
-            ValueError<double> res = hwhp(out, qs, true);
-            dl.line += "\t" + to_string(res.val * 2) + "\t" + to_string(res.err * 2);
-        }
-        if(contains(conf.tasks, "central_amplitude")) {
-            // print absolute value of central spot
-            dl.line += "\t" + to_string(myabs(out(0, 0)));
-        }
-        if(contains(conf.tasks, "in_phase_stat")) {
-            // print the mean and RMS of phase errors in input array
-            ValueError<double> stat = mean_stddev(myarg, in, xs, ys, sp.shape_params[0]);
-            dl.line += "\t" + to_string(stat.val) + "\t" + to_string(stat.err);
-        }
-
-        // find interesting limits if printing is needed. This next bit is ugly, I know.
-        if(any_begins_with(conf.tasks, "print_in")) {
-            // look for in limits
-            proc_log("\tin limits");
-            in_lims = in.find_interesting(myabs, conf.abs_sens, conf.rel_sens);
-        }
-
-        if(any_begins_with(conf.tasks, "print_out") || contains(conf.tasks, "out_lims")) {
-            // this screws up out
-            proc_log("\tfftshift(out)");
-            fftshift(out);
-            ps = fftshift(ps); qs = fftshift(qs);
-            
-            // look for out limits
-            proc_log("\tout limits");
-            out_lims = out.find_interesting(myabs, conf.abs_sens, conf.rel_sens);
-        }
-
-        if(contains(conf.tasks, "out_lims")) {
-            // record the boundaries of the image that are above the given sensitivity
-            // reminder: lims = {imin, imax, jmin, jmax}
-            int imin = out_lims[0], imax = out_lims[1];
-            int jmin = out_lims[2], jmax = out_lims[3];
-            double p1 = ps[jmin], p2 = ps[jmax - 1];
-            double q1 = qs[imin], q2 = qs[imax - 1];
-
-            dl.line += "\t" + to_string(p1) + "\t" + to_string(p2);
-            dl.line += "\t" + to_string(q1) + "\t" + to_string(q2);
-        }
-
-        // DO the array printing. 
-        if(contains(conf.tasks, "print_in_abs")) {
-            proc_log("\tprint_in_abs");
-            // print aperture amplitude
-            string in_fname = conf.out_prefix + to_string(shape_idx) + "in_abs.txt";
-            FILE * in_filep = fopen(in_fname.c_str(), "w");
-            print_lim_array(in_filep, myabs, in, xs, ys, in_lims);
-            fclose(in_filep);
-        }
-        if(contains(conf.tasks, "print_in_phase")) {
-            proc_log("\tprint_in_phase");
-            // print aperture phase
-            string in_fname = conf.out_prefix + to_string(shape_idx) + "in_phase.txt";
-            FILE * in_filep = fopen(in_fname.c_str(), "w");
-            print_lim_array(in_filep, myarg, in, xs, ys, in_lims);
-            fclose(in_filep);
-        }
-        if(contains(conf.tasks, "print_out_abs")) {
-            proc_log("\tprint_out_abs");
-            // print image amplitude
-            string out_fname = conf.out_prefix + to_string(shape_idx) + "out_abs.txt";
-            FILE * out_filep = fopen(out_fname.c_str(), "w");
-            print_lim_array(out_filep, myabs, out, ps, qs, out_lims);
-            fclose(out_filep);
-        }
-        if(contains(conf.tasks, "print_out_phase")) {
-            proc_log("\tprint_out_phase");
-            // print image phase
-            string out_fname = conf.out_prefix + to_string(shape_idx) + "out_phase.txt";
-            FILE * out_filep = fopen(out_fname.c_str(), "w");
-            print_lim_array(out_filep, myarg, out, ps, qs, out_lims);
-            fclose(out_filep);
-        }
-        dataq.push(dl);
-    }
-
-    proc_log("Done. Cleaning up...");
-    fftw_destroy_plan(plan);
+        // the results of the tasks on in wait in res for the ones on out
+        ShapeResults res;
+        auto in_done = [&](const auto& in) {
+            resolve_in_tasks(conf, engine, shape_idx, sp, in, res, proc_log);
+        };
+        // with estimate = validate, both ways of finding the points, before resolve_out_tasks shifts out
+        ShapeResults grid_res, interp_res;
+        auto validate_tasks = [&](const auto& out) {
+            if(!validate) return;
+            TraceSpan span("validate");
+            report_tasks(conf, grid_engine, sp, out, grid_res);
+            report_tasks(conf, interp_engine, sp, out, interp_res);
+        };
+
+        if(radial && radial_generators.count(sp.generator_key)) {
+            proc_log("Hankel transform...");
+            radial_tasks(conf, engine, sp, res);
+            if(validate) {
+                radial_tasks(conf, grid_engine, sp, grid_res);
+                radial_tasks(conf, interp_engine, sp, interp_res);
+            }
+            add_data_fields(conf, sp, res, dl);
+        }
+        else if(conf.precision == "single") {
+            process_shape(conf, pruned, arrays_f, sp, proc_log, in_done, [&](auto& out) {
+                validate_tasks(out);
+                resolve_out_tasks(conf, engine, shape_idx, sp, out, arrays_f, res, dl, proc_log);
+            });
+        }
+        else {
+            ShapeResults dbl_res, sgl_res;
+            process_shape(conf, pruned, arrays, sp, proc_log, in_done, [&](auto& out) {
+                // before resolve_out_tasks, which can shift out
+                if(compare) traced("precision", [&] { report_tasks(conf, precision_engine, sp, out, dbl_res); });
+                validate_tasks(out);
+                resolve_out_tasks(conf, engine, shape_idx, sp, out, arrays, res, dl, proc_log);
+            });
+            if(compare) {
+                proc_log("Again in single precision...");
+                process_shape(conf, pruned, arrays_f, sp, proc_log, [](const auto&) {}, [&](auto& out) {
+                    traced("precision", [&] { report_tasks(conf, precision_engine, sp, out, sgl_res); });
+                });
+                DataLine pl = precision_line(shape_idx, dbl_res, sgl_res);
+                TraceSpan span("write");
+                precision_writer->push(pl);
+                journal.record("precision", pl);
+            }
+        }
+        if(validate) {
+            DataLine vl = validation_line(shape_idx, sp, grid_res, interp_res);
+            TraceSpan span("write");
+            validation_writer->push(vl);
+            journal.record("validation", vl);
+        }
+
+        TraceSpan span("write");
+        writer.push(dl);
+        // the dat record goes last, so it means the whole shape is done
+        journal.record("dat", dl);
+    }
+
+    proc_log("Done.");
+}
+
+
+/** Options given on the command line, as opposed to the config file */
+struct RunOptions {
+    const char * config_filename = NULL;
+    string wisdom_dir = WISDOM_DIR;
+    bool use_wisdom = true;
+    bool patient = false;
+    // carry on from the journal of a previous run that didn't finish
+    bool resume = false;
+    // only do shard number shard of n_shards, for running a config in several processes
+    unsigned int shard = 0, n_shards = 1;
+    // where to write the timings of the stages of every shape, if anywhere
+    string trace_filename;
+};
+
+#define USAGE "Usage: main.exe config_file [--wisdom dir | --no-wisdom] [--patient] [--shard k/N] [--resume] [--trace file.json]"
+
+/** Parse the command line into opts. Returns false if it doesn't make sense */
+bool parse_args(int argc, char * argv[], RunOptions &opts) {
+    for(int i = 1; i < argc; i ++ ) {
+        string arg = argv[i];
+        if(arg == "--wisdom" && i + 1 < argc)
+            opts.wisdom_dir = argv[++i];
+        else if(arg == "--no-wisdom")
+            opts.use_wisdom = false;
+        else if(arg == "--patient")
+            opts.patient = true;
+        else if(arg == "--resume")
+            opts.resume = true;
+        else if(arg == "--trace" && i + 1 < argc)
+            opts.trace_filename = argv[++i];
+        else if(arg == "--shard" && i + 1 < argc) {
+            if(sscanf(argv[++i], "%u/%u", &opts.shard, &opts.n_shards) != 2) return false;
+            if(opts.n_shards == 0 || opts.shard >= opts.n_shards) return false;
+        }
+        else if(arg.find("--") != 0 && opts.config_filename == NULL)
+            opts.config_filename = argv[i];
+        else
+            return false;
+    }
+    return opts.config_filename != NULL;
 }
 
 
@@ -187,11 +588,17 @@ int main(int argc, char * argv[]) {
     // open logger
     Logger main_log(stdout, "main.cpp", INFO_OUT);
 
-    if(argc != 2) {
-        main_log("Incorrect number of arguments. Provide one config file.");
+    RunOptions opts;
+    if(!parse_args(argc, argv, opts)) {
+        main_log("Incorrect arguments. Provide one config file.");
+        main_log(USAGE);
         return 1;
     }
 
+    // before any threads are started
+    if(!opts.trace_filename.empty())
+        tracer.enable();
+
     // init fftw threads
     int threads_status = fftw_init_threads();
     if(threads_status == 0) {
@@ -202,42 +609,138 @@ int main(int argc, char * argv[]) {
     main_log("Thread initialisation successful.");
 
     // parse command line config
-    Config conf(argv[1]);
+    Config conf(opts.config_filename);
+    bool use_single = (conf.precision != "double");
+    bool use_double = (conf.precision != "single");
+    if(use_single) {
+        if(fftwf_init_threads() == 0) {
+            main_log("Single precision thread initialisation failed!");
+            return 1;
+        }
+        fftwf_plan_with_nthreads(N_THREADS);
+    }
+    gen_settings.counter_rng = (conf.rng == "philox");
+    gen_settings.threads = conf.gen_threads;
+    gen_settings.analytic_mask = (conf.corr_mask == "analytic");
     main_log("Configured");
 
-    // Multithread the shape processing
-    unsigned int shapes_per_thread = conf.shapes.size() / N_WORKERS;
+    // pick up the plans from previous runs of the same size, if there were any
+    if(opts.patient) planner_flags = FFTW_PATIENT;
+    bool backward = conf.shapes.has_type(CONV_KEY) || conf.shapes.has_type(SPECTRAL_KEY);
+    string wisdom_fname = wisdom_filename(opts.wisdom_dir, conf.nx, conf.ny, backward, N_THREADS);
+    string wisdom_fname_f = wisdom_filename(opts.wisdom_dir, conf.nx, conf.ny, backward, N_THREADS, true);
+    if(opts.use_wisdom) {
+        if(use_double) {
+            if(load_wisdom(wisdom_fname))
+                main_log("Loaded wisdom from " + wisdom_fname);
+            else
+                main_log("No wisdom in " + wisdom_fname + ". Planning from scratch.");
+        }
+        if(use_single) {
+            if(load_wisdom(wisdom_fname_f, true))
+                main_log("Loaded wisdom from " + wisdom_fname_f);
+            else
+                main_log("No wisdom in " + wisdom_fname_f + ". Planning from scratch.");
+        }
+    }
+
+    // Multithread the shape processing. Workers pull shapes from the scheduler
+    // as they go, the most expensive ones first. The costs are kept per sweep, so
+    // this takes the same memory however many shapes the sweeps expand to
+    vector<CostRange> ranges = cost_ranges(conf.shapes);
+    // in a sharded run, this process only does its share, into its own partial data files
+    unsigned int first = 0, last = conf.shapes.size();
+    shard_range(ranges, opts.shard, opts.n_shards, first, last);
+    if(opts.n_shards > 1)
+        main_log("Shard " + to_string(opts.shard) + " of " + to_string(opts.n_shards) + ": shapes "
+            + to_string(first) + " to " + to_string(last) + " of " + to_string(conf.shapes.size()));
+
+    // data lines go to the file in shape order as they come in
+    OrderedWriter writer(data_filename(conf.out_prefix, "dat", opts.shard, opts.n_shards), first);
+
+    // and the accuracy of single precision to its own file, when comparing
+    bool compare = (conf.precision == "compare");
+    unique_ptr<OrderedWriter> precision_writer;
+    if(compare)
+        precision_writer.reset(new OrderedWriter(data_filename(conf.out_prefix, "precision", opts.shard, opts.n_shards), first));
+
+    // and how the estimates of the points compare with the analytic ones, when validating
+    bool validate = (conf.estimate == "validate");
+    unique_ptr<OrderedWriter> validation_writer;
+    if(validate)
+        validation_writer.reset(new OrderedWriter(data_filename(conf.out_prefix, "validation", opts.shard, opts.n_shards), first));
+
+    // every finished shape is also recorded in the journal. When resuming, the shapes
+    // it has are written straight from there, and the workers only get the rest.
+    // The header has a hash of the config, so an edited config isn't resumed
+    string journal_fname = data_filename(conf.out_prefix, "journal", opts.shard, opts.n_shards);
+    string journal_header = "journal " + to_string(conf.shapes.size()) + " shapes " + to_string(conf.nx) + "x"
+        + to_string(conf.ny) + " " + conf.precision + " " + conf.estimate + " " + conf.radial + " shard " + to_string(opts.shard) + "/" + to_string(opts.n_shards)
+        + " config " + file_hash(opts.config_filename);
+    Journal journal(journal_fname, journal_header, opts.resume);
+
+    auto done = [&](unsigned int idx) {
+        return journal.has("dat", idx) && (!compare || journal.has("precision", idx)) && (!validate || journal.has("validation", idx));
+    };
+    unsigned int n_done = 0;
+    for(const pair<const unsigned int, string> &dat : journal.lines("dat")) {
+        unsigned int idx = dat.first;
+        if(idx < first || idx >= last || !done(idx)) continue;
+        writer.push(DataLine{idx, dat.second});
+        if(compare) precision_writer->push(DataLine{idx, journal.lines("precision").at(idx)});
+        if(validate) validation_writer->push(DataLine{idx, journal.lines("validation").at(idx)});
+        n_done++;
+    }
+    unsigned int n_todo = (last - first) - n_done;
+    if(opts.resume)
+        main_log("Resuming from " + journal_fname + ": " + to_string(n_done) + " shapes done, "
+            + to_string(n_todo) + " to go");
+
+    ShapeScheduler sched(ranges, first, last, done);
     vector<thread> worker_threads;
 
     main_log("Spawning worker threads");
-    for(unsigned int i_th = 0; i_th < N_WORKERS; i_th ++ ) {
-        unsigned int start = i_th * shapes_per_thread;
-        unsigned int end = (i_th + 1) * shapes_per_thread;
-        // the last worker has to finish the shapes
-        if(i_th == N_WORKERS - 1) end = conf.shapes.size();
-
-        if(start < end)
-            // only start workers if they have something to do
-            worker_threads.push_back(thread(shapes_worker, conf, i_th, start, end));
-    }
+    for(unsigned int i_th = 0; i_th < N_WORKERS && i_th < n_todo; i_th ++ )
+        // only start workers if they have something to do
+        worker_threads.push_back(thread(shapes_worker, cref(conf), i_th, ref(sched), ref(writer), precision_writer.get(), validation_writer.get(), ref(journal)));
 
     // join everything when it's done
     for(vector<thread>::iterator th = worker_threads.begin(); th != worker_threads.end(); th++ )
         th->join();
 
-    main_log("Writing data results");
-    // open data file;
-    string data_filename = conf.out_prefix + "dat.txt";
-    FILE * data_filep = fopen(data_filename.c_str(), "w");
-    
-    // print the data
-    DataLine dl;
-    while(!dataq.empty()) {
-        dl = dataq.top();
-        fprintf(data_filep, "%s\n", dl.line.c_str());
-        dataq.pop();
-    }
-    fclose(data_filep);
+    // the shards of a run all plan the same transforms, so only the first one saves them
+    if(opts.use_wisdom && opts.shard == 0) {
+        if(use_double) {
+            if(save_wisdom(wisdom_fname))
+                main_log("Saved wisdom to " + wisdom_fname);
+            else
+                main_log("Could not save wisdom to " + wisdom_fname);
+        }
+        if(use_single) {
+            if(save_wisdom(wisdom_fname_f, true))
+                main_log("Saved wisdom to " + wisdom_fname_f);
+            else
+                main_log("Could not save wisdom to " + wisdom_fname_f);
+        }
+    }
+
+    destroy_shared_plans();
+
+    main_log("Finishing data file");
+    writer.close();
+    if(precision_writer) precision_writer->close();
+    if(validation_writer) validation_writer->close();
+
+    // everything is in the data files now, so there's nothing left to resume
+    journal.close();
+    remove(journal_fname.c_str());
+
+    if(tracer.enabled()) {
+        if(tracer.write_chrome(opts.trace_filename))
+            main_log("Wrote the trace to " + opts.trace_filename + ". Time per stage:\n" + tracer.summary());
+        else
+            main_log("Could not write the trace to " + opts.trace_filename);
+    }
 
     main_log("Done. Exiting.");
     return 0;
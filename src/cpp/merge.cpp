@@ -0,0 +1,102 @@
+#include<cstdio>
+
+#include "util.h"
+
+using namespace std;
+
+#define INFO_OUT true
+
+#define USAGE "Usage: merge.exe config_file N"
+
+/** Copy the partial data files called name of all n_shards shards to out, one after
+ * the other. Each shard has a stretch of consecutive shapes, so the lines should come
+ * in order, from 0 up. Returns false at the first one that doesn't, or if a file is
+ * missing. Only one line is held in memory at a time.
+ */
+bool copy_shards(const Config &conf, const string &name, unsigned int n_shards, FILE * out, unsigned int &n_lines, const Logger &log) {
+    char buff[4096];
+
+    for(unsigned int k = 0; k < n_shards; k ++ ) {
+        string filename = data_filename(conf.out_prefix, name, k, n_shards);
+        FILE * filep = fopen(filename.c_str(), "r");
+        if(filep == NULL) {
+            log("Could not open " + filename);
+            return false;
+        }
+
+        // every line starts with the shape index. Long lines are read in pieces
+        string line;
+        while(fgets(buff, sizeof(buff), filep) != NULL) {
+            line += buff;
+            if(line.back() != '\n' && !feof(filep)) continue;
+            if(line.back() == '\n') line.pop_back();
+
+            unsigned int idx = stoul(line);
+            if(idx != n_lines) {
+                log("Expected shape " + to_string(n_lines) + " next, but " + filename + " has shape "
+                    + to_string(idx) + ". Some shards haven't finished, or are from another run?");
+                fclose(filep);
+                return false;
+            }
+            fprintf(out, "%s\n", line.c_str());
+            n_lines++;
+            line.clear();
+        }
+        fclose(filep);
+    }
+    return true;
+}
+
+/** Merge the partial data files called name into the one a run in one process makes.
+ * Returns false if they don't have every shape of the config exactly once, in which
+ * case the merged file isn't made.
+ */
+bool merge(const Config &conf, const string &name, unsigned int n_shards, const Logger &log) {
+    // written next to where it goes, and only moved there once it's complete
+    string filename = data_filename(conf.out_prefix, name);
+    string part_filename = filename + ".part";
+    FILE * filep = fopen(part_filename.c_str(), "w");
+    if(filep == NULL) {
+        log("Could not open " + part_filename);
+        return false;
+    }
+
+    unsigned int n_lines = 0;
+    bool ok = copy_shards(conf, name, n_shards, filep, n_lines, log);
+    fclose(filep);
+
+    unsigned int n_shapes = conf.shapes.size();
+    if(ok && n_lines != n_shapes) {
+        log("The shards of " + name + " have " + to_string(n_lines) + " shapes, instead of "
+            + to_string(n_shapes) + ". Some shards haven't finished?");
+        ok = false;
+    }
+    if(!ok || rename(part_filename.c_str(), filename.c_str()) != 0) {
+        if(ok) log("Could not write " + filename);
+        remove(part_filename.c_str());
+        return false;
+    }
+
+    log("Merged " + to_string(n_shards) + " shards into " + filename);
+    return true;
+}
+
+
+/** Put together the data files of a config that was run in N shards, with
+ * main.exe config_file --shard k/N for k = 0 .. N-1, once all of them are done.
+ */
+int main(int argc, char * argv[]) {
+    Logger log(stdout, "merge.cpp", INFO_OUT);
+
+    unsigned int n_shards = 0;
+    if(argc != 3 || sscanf(argv[2], "%u", &n_shards) != 1 || n_shards == 0) {
+        log(USAGE);
+        return 1;
+    }
+
+    Config conf(argv[1]);
+    if(!merge(conf, "dat", n_shards, log)) return 1;
+    if(conf.precision == "compare" && !merge(conf, "precision", n_shards, log)) return 1;
+    if(conf.estimate == "validate" && !merge(conf, "validation", n_shards, log)) return 1;
+    return 0;
+}
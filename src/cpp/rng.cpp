@@ -0,0 +1,46 @@
+#include "rng.h"
+
+#include<cmath>
+
+// multipliers and key increments (Weyl sequence) of Philox4x32
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+/** One round of Philox4x32 */
+inline array<uint32_t, 4> philox_round(const array<uint32_t, 4> &ctr, const array<uint32_t, 2> &key) {
+    uint64_t prod0 = (uint64_t)PHILOX_M0 * ctr[0];
+    uint64_t prod1 = (uint64_t)PHILOX_M1 * ctr[2];
+    uint32_t hi0 = prod0 >> 32, lo0 = (uint32_t)prod0;
+    uint32_t hi1 = prod1 >> 32, lo1 = (uint32_t)prod1;
+
+    return {hi1 ^ ctr[1] ^ key[0], lo1, hi0 ^ ctr[3] ^ key[1], lo0};
+}
+
+array<uint32_t, 4> philox4x32(array<uint32_t, 4> ctr, array<uint32_t, 2> key) {
+    for(int r = 0; r < PHILOX_ROUNDS; r ++ ) {
+        if(r > 0) {
+            key[0] += PHILOX_W0;
+            key[1] += PHILOX_W1;
+        }
+        ctr = philox_round(ctr, key);
+    }
+    return ctr;
+}
+
+/** Uniform double in (0, 1) from 53 of the bits in two random words */
+inline double to_uniform(uint32_t hi, uint32_t lo) {
+    uint64_t bits = ((uint64_t)hi << 21) ^ (lo >> 11);
+    return ((bits & ((1ull << 53) - 1)) + 0.5) / 9007199254740992.0;
+}
+
+double philox_gaussian(uint64_t seed, uint32_t stream, uint32_t i, uint32_t j) {
+    array<uint32_t, 4> r = philox4x32({i, j, stream, 0}, {(uint32_t)seed, (uint32_t)(seed >> 32)});
+
+    // Box-Muller, keeping only one of the pair
+    double u1 = to_uniform(r[0], r[1]);
+    double u2 = to_uniform(r[2], r[3]);
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
@@ -0,0 +1,22 @@
+#ifndef MYRNG
+#define MYRNG
+
+#include<cstdint>
+#include<array>
+
+using namespace std;
+
+/** Philox4x32-10, the counter-based random number generator of Salmon et al.
+ * (Random123). The 4 random words it returns are a pure function of the counter
+ * and the key, so any element of a random array can be drawn on its own,
+ * in any order, on any thread, and always come out the same.
+ */
+array<uint32_t, 4> philox4x32(array<uint32_t, 4> ctr, array<uint32_t, 2> key);
+
+/**
+ * A standard normal random number for element (i, j) of the random array
+ * given by seed. Different streams give independent arrays for the same seed.
+ */
+double philox_gaussian(uint64_t seed, uint32_t stream, uint32_t i, uint32_t j);
+
+#endif
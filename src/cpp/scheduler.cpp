@@ -0,0 +1,108 @@
+#include "scheduler.h"
+
+#include<cmath>
+#include<algorithm>
+
+vector<CostRange> cost_ranges(const ShapeList &shapes) {
+    // the cost only depends on the aperture type, which is the same for a whole sweep
+    vector<CostRange> ranges;
+    for(unsigned int is = 0; is < shapes.n_sweeps(); is ++ ) {
+        unsigned int first = shapes.sweep_start(is);
+        ranges.push_back(CostRange{first, first + (unsigned int)shapes.sweep(is).size(), shape_cost(shapes.sweep(is).shape(0))});
+    }
+    return ranges;
+}
+
+/** Hand out the shapes 0 .. n_shapes-1 in config order */
+ShapeScheduler::ShapeScheduler(unsigned int n_shapes) :
+    ShapeScheduler(vector<CostRange>{CostRange{0, n_shapes, 1.0}}) {}
+
+/** Hand out the shapes of the ranges between first and last in decreasing order of cost.
+ * Shapes for which skip is true are passed over, and don't count in size().
+ */
+ShapeScheduler::ShapeScheduler(const vector<CostRange> &ranges, unsigned int first, unsigned int last,
+    function<bool(unsigned int)> skip) : cursor(0), skip(skip) {
+    for(const CostRange &r : ranges) {
+        CostRange clipped{max(r.first, first), min(r.last, last), r.cost};
+        if(clipped.first < clipped.last) order.push_back(clipped);
+    }
+    // ties go to the lowest index, so equal costs keep the order the data is written in
+    sort(order.begin(), order.end(), [](const CostRange &a, const CostRange &b) {
+        return (a.cost != b.cost) ? a.cost > b.cost : a.first < b.first;
+    });
+
+    unsigned int total = 0;
+    for(const CostRange &r : order) {
+        total += r.last - r.first;
+        ends.push_back(total);
+    }
+}
+
+/** Write the next shape index to shape_idx.
+ * Returns false, leaving shape_idx untouched, once all shapes have been handed out.
+ * Safe to call from any number of threads at once.
+ */
+bool ShapeScheduler::next(unsigned int &shape_idx) {
+    while(true) {
+        unsigned int pos = cursor.fetch_add(1);
+        if(ends.empty() || pos >= ends.back()) return false;
+
+        unsigned int ir = upper_bound(ends.begin(), ends.end(), pos) - ends.begin();
+        unsigned int idx = order[ir].first + pos - (ir > 0 ? ends[ir - 1] : 0);
+        if(skip && skip(idx)) continue;
+
+        shape_idx = idx;
+        return true;
+    }
+}
+
+/** Total number of shapes this scheduler hands out. Goes through all of them if some are skipped */
+unsigned int ShapeScheduler::size() const {
+    unsigned int n = 0;
+    for(const CostRange &r : order) {
+        if(!skip) {
+            n += r.last - r.first;
+            continue;
+        }
+        for(unsigned int idx = r.first; idx < r.last; idx ++ )
+            if(!skip(idx)) n++;
+    }
+    return n;
+}
+
+
+/** Index of the first shape of shard k: the first one whose middle is past a fraction
+ * k / n_shards of the total cost. Only depends on the ranges, so every shard agrees on it.
+ */
+static unsigned int shard_start(const vector<CostRange> &ranges, unsigned int k, unsigned int n_shards) {
+    double total = 0.0;
+    for(const CostRange &r : ranges)
+        total += (r.last - r.first) * r.cost;
+    double target = total * k / n_shards;
+
+    double before = 0.0;
+    for(const CostRange &r : ranges) {
+        unsigned int n = r.last - r.first;
+        if(n > 0 && before + (n - 0.5) * r.cost >= target) {
+            double skipped = ceil((target - before) / r.cost - 0.5);
+            return r.first + (unsigned int)max(skipped, 0.0);
+        }
+        before += n * r.cost;
+    }
+    return ranges.empty() ? 0 : ranges.back().last;
+}
+
+void shard_range(const vector<CostRange> &ranges, unsigned int k, unsigned int n_shards, unsigned int &first, unsigned int &last) {
+    first = shard_start(ranges, k, n_shards);
+    last = shard_start(ranges, k + 1, n_shards);
+}
+
+
+double shape_cost(const ShapeProperties &sp) {
+    // the correlated errors need 3 FFTs on top of the one every shape gets (the one
+    // for the mask is cached now, but the depth is still drawn, shifted and turned into
+    // the aperture on top), the spectral ones just 1
+    if(sp.generator_key == CONV_KEY) return 4.0;
+    if(sp.generator_key == SPECTRAL_KEY) return 2.0;
+    return 1.0;
+}
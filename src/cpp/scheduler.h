@@ -0,0 +1,69 @@
+#ifndef SCHEDULER
+#define SCHEDULER
+
+#include<vector>
+#include<atomic>
+#include<climits>
+#include<functional>
+
+#include "util.h"
+using namespace std;
+
+/** The shapes first .. last - 1, which all cost about the same.
+ * A config has one of these per sweep, so they take no more memory
+ * than the config does, however many shapes the sweeps expand to.
+ */
+struct CostRange {
+    unsigned int first, last;
+    double cost;
+};
+
+/** The shapes of the list as one CostRange per sweep, in config order */
+vector<CostRange> cost_ranges(const ShapeList &shapes);
+
+/** Hands out shape indices to worker threads on demand, instead of
+ * splitting the config into fixed ranges up front. Every worker pulls
+ * the next index from a shared cursor, so a worker that got cheap shapes
+ * just comes back for more while another one is stuck on an expensive one.
+ * 
+ * If costs are given, the most expensive shapes are handed out first,
+ * which keeps the slow ones from piling up at the end of the run.
+ * Shapes of equal cost go in increasing index order. The catch is that the
+ * data file is written in index order, so if the first shapes are cheap,
+ * nothing can be written until the expensive ones after them are done, and
+ * the lines in between wait in the OrderedWriter. The run as a whole still
+ * finishes sooner, which is what matters for long runs.
+ */
+class ShapeScheduler {
+private:
+    // the ranges in the order they're handed out, and how many shapes
+    // have been handed out by the end of each one
+    vector<CostRange> order;
+    vector<unsigned int> ends;
+    atomic<unsigned int> cursor;
+    function<bool(unsigned int)> skip;
+
+public:
+    ShapeScheduler(unsigned int n_shapes);
+    ShapeScheduler(const vector<CostRange> &ranges, unsigned int first = 0, unsigned int last = UINT_MAX,
+        function<bool(unsigned int)> skip = nullptr);
+
+    bool next(unsigned int &shape_idx);
+    unsigned int size() const;
+};
+
+/**
+ * The shapes first .. last - 1 that shard k (from 0 to n_shards - 1) of a run split
+ * over n_shards processes does. Each shard gets a stretch of consecutive shapes of
+ * about the same total cost, and every process works that out the same way from
+ * the ranges, so together they do every shape once.
+ */
+void shard_range(const vector<CostRange> &ranges, unsigned int k, unsigned int n_shards, unsigned int &first, unsigned int &last);
+
+/**
+ * Rough relative cost of processing a shape, in units of one full-size FFT.
+ * Only the ordering matters, so this doesn't need to be accurate.
+ */
+double shape_cost(const ShapeProperties &sp);
+
+#endif
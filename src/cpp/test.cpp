@@ -1,6 +1,15 @@
 #include<cstdio>
+#include<tuple>
 
+#include<gsl/gsl_sf_bessel.h>
+
+#include "analysis.h"
 #include "array2d.h"
+#include "fft.h"
+#include "scheduler.h"
+#include "writer.h"
+#include "rng.h"
+#include "trace.h"
 
 #define VERBOSE true
 
@@ -170,6 +179,99 @@ void test_array2d_fftshift(bool verbose = false) {
     printf("OK\n");
 }
 
+void test_inplace_fftshift(bool verbose = false) {
+    printf("test_inplace_fftshift : ");
+
+    // compare with the plain modulo-indexed gather, for all parities of sizes
+    vector<pair<int, int>> sizes = {{4, 6}, {5, 7}, {4, 7}, {7, 4}, {1, 3}, {2, 1}};
+    for(auto size : sizes) {
+        int nx = size.first, ny = size.second;
+        Array2d a(nx, ny), expected(nx, ny);
+        for(int i = 0; i < nx; i ++ )
+            for(int j = 0; j < ny; j ++ ) {
+                a[i][j] = complex<double>(i, j);
+                expected[i][j] = complex<double>((i + (nx+1)/2) % nx, (j + (ny+1)/2) % ny);
+            }
+        fftshift(a);
+
+        if(!(a == expected)) {
+            conditional_print(verbose, "a", a);
+            printf("FAILED for %d x %d\n", nx, ny);
+            return;
+        }
+    }
+
+    // for even sizes, modulating the input does the same as shifting the output
+    int nx = 8, ny = 6;
+    Array2d in(nx, ny), shifted(nx, ny), modulated(nx, ny);
+    for(int i = 0; i < nx; i ++ )
+        for(int j = 0; j < ny; j ++ )
+            in[i][j] = complex<double>(sin(i + 2.0 * j), cos(3.0 * i - j));
+
+    fftw_plan plan = fftw_plan_dft_2d(nx, ny, in.ptr(), shifted.ptr(), FFTW_FORWARD, FFTW_ESTIMATE);
+    fftw_execute(plan);
+    fftshift(shifted);
+    checkerboard(in);
+    fftw_execute_dft(plan, in.ptr(), modulated.ptr());
+    fftw_destroy_plan(plan);
+
+    if(!(shifted == modulated)) {
+        conditional_print(verbose, "shifted", shifted);
+        conditional_print(verbose, "modulated", modulated);
+        printf("FAILED for the modulation\n");
+        return;
+    }
+    printf("OK\n");
+}
+
+/** the real overloads of the projections must agree with the complex ones */
+template <typename P>
+bool same_on_reals(P fun, const vector<double> &vals) {
+    for(double x : vals) {
+        double a = fun(x), b = fun(complex<double>(x));
+        if(a != b && !(isnan(a) && isnan(b))) return false;
+    }
+    return true;
+}
+
+void test_projections(bool verbose = false) {
+    printf("test_projections : ");
+
+    vector<double> vals = {0.0, -0.0, 1.5, -2.25, 1e-300, -1e300};
+    if(!same_on_reals(myabs, vals) || !same_on_reals(myarg, vals) || !same_on_reals(myre, vals)
+            || !same_on_reals(complexness, vals) || !same_on_reals(mynorm, vals)) {
+        printf("FAILED on reals\n");
+        return;
+    }
+
+    complex<double> z(3.0, -4.0);
+    if(myabs(z) != 5.0 || mynorm(z) != 25.0 || myre(z) != 3.0 || myarg(z) != atan2(-4.0, 3.0)) {
+        printf("FAILED on complex\n");
+        return;
+    }
+    printf("OK\n");
+}
+
+/** find_interesting as it was, comparing abs(z) with the thresholds */
+Limits abs_limits(const Array2d &a, double abs_sens, double rel_sens) {
+    if(abs_sens == 0.0) abs_sens = INFINITY;
+    if(rel_sens == 0.0) rel_sens = 2.0;
+
+    double abs_max = 0.0;
+    for(int i = 0; i < a.rows(); i ++ )
+        for(int j = 0; j < a.cols(); j ++ )
+            abs_max = max(abs_max, abs(a(i, j)));
+
+    Limits lim{a.rows(), 0, a.cols(), 0};
+    for(int i = 0; i < a.rows(); i ++ )
+        for(int j = 0; j < a.cols(); j ++ )
+            if(abs(a(i, j)) > rel_sens * abs_max || abs(a(i, j)) > abs_sens) {
+                lim[0] = min(lim[0], i); lim[1] = max(lim[1], i + 1);
+                lim[2] = min(lim[2], j); lim[3] = max(lim[3], j + 1);
+            }
+    return lim;
+}
+
 void test_find_interesting(bool verbose = false) {
     printf("test_find_interesting : ");
 
@@ -210,6 +312,916 @@ void test_find_interesting(bool verbose = false) {
         return;
     }
 
+    // elements right on the thresholds (5, and half the max of 10), and one a rounding
+    // error above them, must come out the same as comparing abs() the way it used to
+    Array2d b(3, 4);
+    for(int i = 0; i < 3; i ++ )
+        for(int j = 0; j < 4; j ++ ) b[i][j] = complex<double>(3.0, 4.0);
+    b[0][0] = complex<double>(-4.0, 3.0);
+    b[1][3] = complex<double>(3.0, nextafter(4.0, 5.0));
+    b[2][1] = complex<double>(6.0, -8.0);
+    for(int i = 0; i < 2; i ++ ) {
+        Limits key_lim = (i == 0) ? b.find_interesting(myabs, 5.0, 0.0) : b.find_interesting(myabs, 0.0, 0.5);
+        Limits abs_lim = (i == 0) ? abs_limits(b, 5.0, 0.0) : abs_limits(b, 0.0, 0.5);
+        if(verbose) printf("\nborderline: %s, with abs %s", lims_to_str(key_lim).c_str(), lims_to_str(abs_lim).c_str());
+        if(key_lim != abs_lim || key_lim != Limits{1, 3, 1, 4}) {
+            printf("FAILED on the %s threshold.\n", (i == 0) ? "absolute" : "relative");
+            return;
+        }
+    }
+
+    printf("OK\n");
+}
+
+/** Hand out every shape of sched and check they come in the order exp_order */
+bool check_schedule(ShapeScheduler &sched, const vector<unsigned int> &exp_order, bool verbose) {
+    if(sched.size() != exp_order.size()) {
+        printf("FAILED: %u shapes to hand out, expected %zu\n", sched.size(), exp_order.size());
+        return false;
+    }
+    unsigned int idx;
+    for(unsigned int i = 0; i < exp_order.size(); i ++ ) {
+        if(!sched.next(idx)) {
+            printf("FAILED: ran out after %u shapes\n", i);
+            return false;
+        }
+        if(verbose) printf("%u ", idx);
+        if(idx != exp_order[i]) {
+            printf("FAILED: position %u expected %u got %u\n", i, exp_order[i], idx);
+            return false;
+        }
+    }
+    if(sched.next(idx)) {
+        printf("FAILED: handed out more shapes than it has\n");
+        return false;
+    }
+    return true;
+}
+
+void test_scheduler(bool verbose = false) {
+    printf("test_scheduler : ");
+
+    // expensive shapes first, ties in config order
+    ShapeScheduler sched({{0, 1, 1.0}, {1, 2, 4.0}, {2, 3, 1.0}, {3, 4, 4.0}, {4, 5, 2.0}});
+    if(!check_schedule(sched, {1, 3, 4, 0, 2}, verbose)) return;
+
+    // sweeps of several shapes, only some of them, passing over the ones already done
+    ShapeScheduler part({{0, 3, 1.0}, {3, 5, 4.0}, {5, 7, 2.0}}, 1, 6,
+        [](unsigned int idx) { return idx == 4; });
+    if(!check_schedule(part, {3, 5, 1, 2}, verbose)) return;
+
+    // equal costs by index, whatever order the ranges are listed in
+    ShapeScheduler ties({{3, 5, 1.0}, {0, 3, 1.0}});
+    if(!check_schedule(ties, {0, 1, 2, 3, 4}, verbose)) return;
+
+    printf("OK\n");
+}
+
+void test_shards(bool verbose = false) {
+    printf("test_shards : ");
+
+    // every shape in exactly one shard, and the shards about as costly as each other
+    vector<CostRange> ranges = {{0, 4, 3.0}, {4, 10, 1.0}, {10, 12, 2.0}, {12, 20, 1.0}};
+    unsigned int n_shapes = 20, n_shards = 3;
+    vector<int> times_done(n_shapes, 0);
+    double min_total = INFINITY, max_total = 0.0;
+
+    for(unsigned int k = 0; k < n_shards; k ++ ) {
+        unsigned int first, last;
+        shard_range(ranges, k, n_shards, first, last);
+        double total = 0.0;
+        for(unsigned int idx = first; idx < last; idx ++ ) {
+            times_done[idx]++;
+            for(const CostRange &r : ranges)
+                if(idx >= r.first && idx < r.last) total += r.cost;
+        }
+        min_total = min(min_total, total);
+        max_total = max(max_total, total);
+        if(verbose) printf("\nshard %u: shapes %u to %u, cost %f", k, first, last, total);
+
+        // its writer only waits for its own shapes
+        const char * fname = "test_output.txt";
+        OrderedWriter writer(fname, first);
+        for(unsigned int idx = last; idx -- > first; )
+            writer.push(DataLine{idx, to_string(idx)});
+        writer.close();
+
+        FILE * filep = fopen(fname, "r");
+        unsigned int read_idx;
+        for(unsigned int idx = first; idx < last; idx ++ )
+            if(fscanf(filep, " %u", &read_idx) != 1 || read_idx != idx) {
+                printf("FAILED: shard %u written out of order\n", k);
+                fclose(filep);
+                return;
+            }
+        fclose(filep);
+        remove(fname);
+    }
+    if(count(times_done.begin(), times_done.end(), 1) != (int)n_shapes) {
+        printf("FAILED: not every shape done once\n");
+        return;
+    }
+    if(max_total - min_total > 3.0) {
+        printf("FAILED: unbalanced, %f to %f\n", min_total, max_total);
+        return;
+    }
+    printf("OK\n");
+}
+
+void test_ordered_writer(bool verbose = false) {
+    printf("test_ordered_writer : ");
+
+    const char * fname = "test_output.txt";
+    vector<unsigned int> push_order = {2, 0, 4, 3, 1};
+
+    // push from several threads at once, out of order
+    OrderedWriter writer(fname);
+    vector<thread> pushers;
+    for(unsigned int i = 0; i < push_order.size(); i ++ ) {
+        DataLine dl{push_order[i], "line" + to_string(push_order[i])};
+        pushers.push_back(thread([&writer, dl]{ writer.push(dl); }));
+    }
+    for(unsigned int i = 0; i < pushers.size(); i ++ )
+        pushers[i].join();
+    writer.close();
+
+    FILE * filep = fopen(fname, "r");
+    char buff[64];
+    for(unsigned int i = 0; i < push_order.size(); i ++ ) {
+        string expected = "line" + to_string(i);
+        if(fscanf(filep, " %63s", buff) != 1 || expected != buff) {
+            printf("FAILED: line %u should be %s\n", i, expected.c_str());
+            fclose(filep);
+            return;
+        }
+        if(verbose) printf("%s ", buff);
+    }
+    fclose(filep);
+    remove(fname);
+    printf("OK\n");
+}
+
+void test_journal(bool verbose = false) {
+    printf("test_journal : ");
+    const char * fname = "test_journal.txt";
+    string header = "journal test";
+
+    {
+        Journal journal(fname, header, false);
+        journal.record("precision", DataLine{2, "2\t0.5"});
+        journal.record("dat", DataLine{2, "2\t1.0\t2.0"});
+        journal.record("dat", DataLine{0, "0\t3.0\t4.0"});
+    }
+    // a record cut short by the run getting killed
+    FILE * filep = fopen(fname, "a");
+    fprintf(filep, "dat 1\t5.");
+    fclose(filep);
+
+    {
+        Journal journal(fname, header, true);
+        if(!journal.has("dat", 0) || !journal.has("dat", 2) || !journal.has("precision", 2)
+            || journal.has("dat", 1) || journal.has("precision", 0)) {
+            printf("FAILED: wrong records recovered\n");
+            return;
+        }
+        if(journal.lines("dat").at(2) != "2\t1.0\t2.0") {
+            printf("FAILED: recovered \"%s\"\n", journal.lines("dat").at(2).c_str());
+            return;
+        }
+        journal.record("dat", DataLine{1, "1\t5.0\t6.0"});
+    }
+
+    {
+        // the cut off record is gone, and the new one is readable
+        Journal journal(fname, header, true);
+        if(verbose) printf("\n%zu dat records", journal.lines("dat").size());
+        if(journal.lines("dat").size() != 3 || journal.lines("dat").at(1) != "1\t5.0\t6.0") {
+            printf("FAILED: record after the cut off one is wrong\n");
+            return;
+        }
+    }
+
+    // a journal of another run can't be resumed
+    try {
+        Journal journal(fname, "journal other", true);
+        printf("FAILED: resumed from the wrong journal\n");
+        return;
+    }
+    catch(runtime_error &e) {
+        if(verbose) printf("\n%s\n", e.what());
+    }
+
+    // the header has the hash of the config, which changes when the config is edited
+    const char * cnf_fname = "test_config_hash.txt";
+    filep = fopen(cnf_fname, "w");
+    fprintf(filep, "nx = 128\n");
+    fclose(filep);
+    string hash = file_hash(cnf_fname);
+    filep = fopen(cnf_fname, "w");
+    fprintf(filep, "nx = 256\n");
+    fclose(filep);
+    string edited_hash = file_hash(cnf_fname);
+    remove(cnf_fname);
+    if(verbose) printf("config hashes %s %s\n", hash.c_str(), edited_hash.c_str());
+    if(hash.size() != 16 || hash == edited_hash) {
+        printf("FAILED: config hash %s didn't change to %s\n", hash.c_str(), edited_hash.c_str());
+        return;
+    }
+
+    // and without resuming, it starts over
+    {
+        Journal journal(fname, header, false);
+    }
+    {
+        Journal journal(fname, header, true);
+        if(journal.has("dat", 0)) {
+            printf("FAILED: didn't start over\n");
+            return;
+        }
+    }
+    remove(fname);
+    printf("OK\n");
+}
+
+/** Write a config with the given shapes, for the tests that parse one */
+void write_test_config(const char * fname, int n_shapes, const char * shapes) {
+    FILE * filep = fopen(fname, "w");
+    fprintf(filep, "nx = 64\nny = 64\nprefix = data/test\ntasks = params\nrel_sens = 0\nabs_sens = 0\n");
+    fprintf(filep, "n_shapes = %d\n\n%s", n_shapes, shapes);
+    fclose(filep);
+}
+
+void test_sweeps(bool verbose = false) {
+    printf("test_sweeps : ");
+    const char * fname = "test_config.txt";
+
+    // a plain shape, then 2 * 4 combinations, each done twice
+    write_test_config(fname, 17,
+        "type = circular\nlx = 10\nly = 10\nparams = 3 \n\n"
+        "type = corr_errors\nlx = 20\nly = 30\nparams = 5 1,3 0 0:0.3:4 100+ 0.5\nrepeat = 2\n");
+    Config conf(fname);
+
+    vector<vector<double>> expected = {
+        {3},
+        {5, 1, 0, 0.0, 100, 0.5},
+        {5, 1, 0, 0.0, 101, 0.5},
+        {5, 1, 0, 0.1, 102, 0.5},
+        {5, 3, 0, 0.3, 114, 0.5},
+        {5, 3, 0, 0.3, 115, 0.5}
+    };
+    vector<unsigned int> indices = {0, 1, 2, 3, 15, 16};
+    if(conf.shapes.size() != 17 || !conf.shapes.has_type(CONV_KEY) || conf.shapes.has_type(SPECTRAL_KEY)) {
+        printf("FAILED: %u shapes\n", conf.shapes.size());
+        return;
+    }
+    for(unsigned int i = 0; i < indices.size(); i ++ ) {
+        ShapeProperties sp = conf.shapes[indices[i]];
+        bool same = (sp.shape_params.size() == expected[i].size());
+        for(unsigned int ip = 0; same && ip < expected[i].size(); ip ++ )
+            same = DBL_EQ(sp.shape_params[ip], expected[i][ip]);
+        if(verbose) printf("\nshape %u: %s %f %f, %zu params", indices[i], sp.generator_key.c_str(), sp.lx, sp.ly, sp.shape_params.size());
+        if(!same || sp.generator_key != (i == 0 ? "circular" : CONV_KEY) || sp.lx != (i == 0 ? 10 : 20)) {
+            printf("FAILED: shape %u is wrong\n", indices[i]);
+            return;
+        }
+    }
+
+    // a count that doesn't add up, or params that don't make sense, are errors
+    vector<pair<int, const char *>> bad = {
+        {4, "type = circular\nlx = 10\nly = 10\nparams = 1,2,3\n"},
+        {2, "type = circular\nlx = 10\nly = 10\nparams = 1:2\n"},
+        {2, "type = circular\nlx = 10\nly = 10\nparams = 1,,2\n"},
+        {2, "type = circular\nlx = 10\nly = 10\nparams = 1:2:2\nrepeat = 0\n"}
+    };
+    for(auto &b : bad) {
+        write_test_config(fname, b.first, b.second);
+        try {
+            Config bad_conf(fname);
+            printf("FAILED: accepted %s\n", b.second);
+            return;
+        }
+        catch(runtime_error &e) {
+            if(verbose) printf("\n%s", e.what());
+        }
+    }
+
+    // and the whole of a long one goes in the message
+    string long_list = "1";
+    for(int k = 0; k < 150; k ++ )
+        long_list += ",2";
+    long_list += ",x";
+    write_test_config(fname, 152, ("type = circular\nlx = 10\nly = 10\nparams = " + long_list + "\n").c_str());
+    try {
+        Config bad_conf(fname);
+        printf("FAILED: accepted a long bad list\n");
+        return;
+    }
+    catch(runtime_error &e) {
+        if(string(e.what()).find(long_list) == string::npos) {
+            printf("FAILED: the message is %s\n", e.what());
+            return;
+        }
+    }
+    remove(fname);
+    printf("OK\n");
+}
+
+void test_trace(bool verbose = false) {
+    printf("test_trace : ");
+
+    // 20 spans of 1 .. 20 ms from two workers, and one from outside them
+    Tracer t;
+    t.enable();
+    for(int k = 1; k <= 20; k ++ ) {
+        trace_context(k % 2, k);
+        t.add("fft", 0.0, 1000.0 * k);
+    }
+    trace_context(-1, -1);
+    t.add("plan", 0.0, 500.0);
+
+    string summary = t.summary();
+    if(verbose) printf("\n%s", summary.c_str());
+    char name[20];
+    unsigned int count;
+    double total, p50, p95, longest;
+    // the header, then fft first, with the most time
+    size_t line = summary.find('\n') + 1;
+    if(sscanf(summary.c_str() + line, "%19s %u %lf %lf %lf %lf", name, &count, &total, &p50, &p95, &longest) != 6
+            || string(name) != "fft" || count != 20 || total != 210.0 || p50 != 10.0 || p95 != 19.0 || longest != 20.0) {
+        printf("FAILED: summary\n%s", summary.c_str());
+        return;
+    }
+
+    // every event goes in the trace, on the track of its worker, with its shape
+    const char * fname = "test_trace.json";
+    if(!t.write_chrome(fname)) {
+        printf("FAILED: could not write %s\n", fname);
+        return;
+    }
+    FILE * filep = fopen(fname, "r");
+    char buff[300];
+    int n_events = 0;
+    bool found = false;
+    while(fgets(buff, sizeof(buff), filep) != NULL) {
+        if(strstr(buff, "\"ph\": \"X\"") != NULL) n_events ++;
+        if(strstr(buff, "\"tid\": 2, \"ts\": 0.000, \"dur\": 3000.000, \"args\": {\"shape\": 3}") != NULL) found = true;
+    }
+    fclose(filep);
+    remove(fname);
+    if(n_events != 21 || !found) {
+        printf("FAILED: %d events in the trace\n", n_events);
+        return;
+    }
+    printf("OK\n");
+}
+
+void test_expand_hermitian(bool verbose = false) {
+    printf("test_expand_hermitian : ");
+
+    // odd and even number of columns
+    vector<int> ns = {5, 6};
+    for(unsigned int k = 0; k < ns.size(); k ++ ) {
+        int nx = 4, ny = ns[k];
+        RealArray2d re(nx, ny);
+        Array2d cplx(nx, ny), full(nx, ny), half(nx, ny/2 + 1), expanded(nx, ny);
+
+        for(int i = 0; i < nx; i ++ )
+            for(int j = 0; j < ny; j ++ )
+                cplx[i][j] = re[i][j] = sin(3.0*i + j*j);
+
+        // transform the same data as real and as complex
+        fftw_plan r2c = fftw_plan_dft_r2c_2d(nx, ny, re.ptr(), half.ptr(), FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+        fftw_plan c2c = fftw_plan_dft_2d(nx, ny, cplx.ptr(), full.ptr(), FFTW_FORWARD, FFTW_ESTIMATE);
+        fftw_execute(r2c);
+        fftw_execute(c2c);
+        fftw_destroy_plan(r2c);
+        fftw_destroy_plan(c2c);
+
+        expand_hermitian(half, expanded);
+        conditional_print(verbose, "full", full);
+        conditional_print(verbose, "expanded", expanded);
+
+        if(!(expanded == full)) {
+            printf("FAILED for %d x %d\n", nx, ny);
+            return;
+        }
+    }
+    printf("OK\n");
+}
+
+void test_pruned_dft(bool verbose = false) {
+    printf("test_pruned_dft : ");
+
+    int nx = 2 * PRUNE_BLOCK, ny = 6;
+    Array2d in(nx, ny), full(nx, ny), pruned(nx, ny);
+    RealArray2d re(nx, ny);
+    Array2d half(nx, ny/2 + 1), pruned_half(nx, ny/2 + 1);
+
+    // a few non-zero rows in the middle, across a block boundary
+    PrunedPlan plan = shared_pruned_plan(nx, ny, in.ptr(), pruned.ptr());
+    PrunedPlan plan_r2c = shared_pruned_plan_r2c(nx, ny, re.ptr(), pruned_half.ptr());
+    PrunedPlan plan_in_place = shared_pruned_plan(nx, ny, in.ptr(), in.ptr());
+    int first_row, last_row;
+    for(int i = 0; i < nx; i ++ )
+        for(int j = 0; j < ny; j ++ )
+            in[i][j] = re[i][j] = (i >= 5 && i < 10) ? cos(i + 2.0*j) : 0.0;
+
+    nonzero_rows(in, first_row, last_row);
+    if(first_row != 5 || last_row != 10) {
+        printf("FAILED: nonzero rows %d -- %d\n", first_row, last_row);
+        return;
+    }
+
+    fftw_plan full_plan = fftw_plan_dft_2d(nx, ny, in.ptr(), full.ptr(), FFTW_FORWARD, FFTW_ESTIMATE);
+    fftw_plan half_plan = fftw_plan_dft_r2c_2d(nx, ny, re.ptr(), half.ptr(), FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+    fftw_execute(full_plan);
+    fftw_execute(half_plan);
+    fftw_destroy_plan(full_plan);
+    fftw_destroy_plan(half_plan);
+
+    execute_pruned(plan, nx, ny, in.ptr(), pruned.ptr(), first_row, last_row);
+    execute_pruned_r2c(plan_r2c, nx, ny, re.ptr(), pruned_half.ptr(), first_row, last_row);
+    conditional_print(verbose, "full", full);
+    conditional_print(verbose, "pruned", pruned);
+
+    if(!(pruned == full)) {
+        printf("FAILED complex\n");
+        return;
+    }
+    if(!(pruned_half == half)) {
+        printf("FAILED r2c\n");
+        return;
+    }
+
+    // and in place, which overwrites in with the same thing
+    execute_pruned(plan_in_place, nx, ny, in.ptr(), in.ptr(), first_row, last_row);
+    if(!(in == full)) {
+        printf("FAILED in place\n");
+        return;
+    }
+    printf("OK\n");
+}
+
+void test_zoom_dft(bool verbose = false) {
+    printf("test_zoom_dft : ");
+
+    // at the frequencies of the FFT, it's the FFT, rows and columns the right way round
+    int nx = 8, ny = 6;
+    double dx = 0.7, dy = 1.3;
+    Array2d in(nx, ny), full(nx, ny), zoom(nx, ny), real_zoom(nx, ny);
+    RealArray2d re(nx, ny);
+    for(int i = 0; i < nx; i ++ )
+        for(int j = 0; j < ny; j ++ ) {
+            bool inside = (i >= 2 && i < 6 && j >= 1 && j < 4);
+            in[i][j] = inside ? complex<double>(cos(i + 2.0*j), sin(3.0*i - j)) : 0.0;
+            re[i][j] = inside ? cos(i + 2.0*j) : 0.0;
+        }
+    fftw_plan full_plan = fftw_plan_dft_2d(nx, ny, in.ptr(), full.ptr(), FFTW_FORWARD, FFTW_ESTIMATE);
+    fftw_execute(full_plan);
+    fftw_destroy_plan(full_plan);
+
+    vector<double> ps = fftfreq(ny, dx / (2*M_PI)), qs = fftfreq(nx, dy / (2*M_PI));
+    zoom_dft(in, dx, dy, ps, qs, zoom);
+    conditional_print(verbose, "full", full);
+    conditional_print(verbose, "zoom", zoom);
+    if(!(zoom == full)) {
+        printf("FAILED: not the FFT\n");
+        return;
+    }
+
+    // and the transform of a real array is that of the same complex one
+    Array2d re_complex(nx, ny);
+    for(int i = 0; i < nx; i ++ )
+        for(int j = 0; j < ny; j ++ )
+            re_complex[i][j] = re[i][j];
+    zoom_dft(re, dx, dy, ps, qs, real_zoom);
+    zoom_dft(re_complex, dx, dy, ps, qs, zoom);
+    if(!(real_zoom == zoom)) {
+        printf("FAILED: real input\n");
+        return;
+    }
+
+    // anywhere else, a point at (i0, j0) transforms to exp(-i (q i0 dy + p j0 dx))
+    int i0 = 3, j0 = 5;
+    Array2d point(nx, ny), fine(3, 4);
+    point[i0][j0] = 1.0;
+    vector<double> fine_ps = {0.0, 0.123, -2.5, 7.0}, fine_qs = {0.01, 1.0, -0.4};
+    zoom_dft(point, dx, dy, fine_ps, fine_qs, fine);
+    for(int k = 0; k < 3; k ++ )
+        for(int l = 0; l < 4; l ++ ) {
+            complex<double> expected = polar(1.0, -(fine_qs[k] * i0 * dy + fine_ps[l] * j0 * dx));
+            if(abs(fine[k][l] - expected) > EPS) {
+                printf("FAILED: off the grid, at %d %d\n", k, l);
+                return;
+            }
+        }
+    printf("OK\n");
+}
+
+void test_tiled_dft(bool verbose = false) {
+    printf("test_tiled_dft : ");
+
+    // mapped arrays, with tiles of 4 columns, so the last one is narrower
+    int nx = 12, ny = 10;
+    size_t tile_bytes = 4 * nx * sizeof(complex<double>);
+    Array2d in(nx, ny, "."), full(nx, ny);
+    RealArray2d re(nx, ny, ".");
+    Array2d half(nx, ny/2 + 1), tiled_half(nx, ny/2 + 1, ".");
+    if(!in.is_mapped() || full.is_mapped()) {
+        printf("FAILED: not mapped\n");
+        return;
+    }
+
+    TiledPlan plan = shared_tiled_plan(nx, ny, in.ptr(), in.ptr(), tile_bytes);
+    TiledPlan plan_r2c = shared_tiled_plan_r2c(nx, ny, re.ptr(), tiled_half.ptr(), tile_bytes);
+    for(int i = 0; i < nx; i ++ )
+        for(int j = 0; j < ny; j ++ )
+            in[i][j] = re[i][j] = (i >= 3 && i < 9) ? sin(i + 3.0*j) : 0.0;
+
+    fftw_plan full_plan = fftw_plan_dft_2d(nx, ny, in.ptr(), full.ptr(), FFTW_FORWARD, FFTW_ESTIMATE);
+    fftw_plan half_plan = fftw_plan_dft_r2c_2d(nx, ny, re.ptr(), half.ptr(), FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+    fftw_execute(full_plan);
+    fftw_execute(half_plan);
+    fftw_destroy_plan(full_plan);
+    fftw_destroy_plan(half_plan);
+
+    // in place, only the rows that aren't zero, and r2c all of them
+    execute_tiled(plan, nx, ny, in.ptr(), in.ptr(), 3, 9);
+    execute_tiled_r2c(plan_r2c, nx, ny, re.ptr(), tiled_half.ptr(), 0, nx);
+    conditional_print(verbose, "full", full);
+    conditional_print(verbose, "tiled", in);
+
+    if(!(in == full)) {
+        printf("FAILED complex\n");
+        return;
+    }
+    if(!(tiled_half == half)) {
+        printf("FAILED r2c\n");
+        return;
+    }
+    printf("OK\n");
+}
+
+void test_row_spans(bool verbose = false) {
+    printf("test_row_spans : ");
+
+    // odd and even sizes, hole and no hole. Compare with checking every point
+    int nx = 33, ny = 40;
+    vector<double> xs = coords(10.0, ny), ys = coords(9.0, nx);
+    vector<vector<double>> all_params = {{3.0, 2.0, 0.0}, {3.0, 2.0, 1.1}, {4.5, 1.0, 5.0}};
+
+    RealArray2d a(nx, ny);
+    for(unsigned int k = 0; k < all_params.size(); k ++ ) {
+        vector<double> params = all_params[k];
+        generators.at("gaussian_hole").real_gen(a, xs, ys, params);
+
+        for(int i = 0; i < nx; i ++ )
+            for(int j = 0; j < ny; j ++ ) {
+                double rsq = xs[j] * xs[j] + ys[i] * ys[i];
+                double expected = 0.0;
+                if(rsq <= params[0] * params[0] && rsq >= params[2] * params[2])
+                    expected = exp(-rsq / (2.0 * params[1] * params[1]));
+
+                if(a(i, j) != expected) {
+                    if(verbose) printf("\n(%d, %d) expected %f got %f", i, j, expected, a(i, j));
+                    printf("FAILED for params %u\n", k);
+                    return;
+                }
+            }
+    }
+    printf("OK\n");
+}
+
+void test_subgrid(bool verbose = false) {
+    printf("test_subgrid : ");
+
+    // the Airy pattern of a circle of radius 3 and the sinc of a slit of width 4, sampled
+    // every 2 pi / 50 like the FFT of an array of side 50, with the frequencies in FFT order
+    vector<double> ps = fftfreq(128, 50.0 / 128 / (2*M_PI));
+    double radius = 3.0, width = 4.0;
+    vector<double> airy(ps.size()), sinc(ps.size());
+    for(unsigned int j = 0; j < ps.size(); j ++ ) {
+        double x = ps[j] * radius, u = ps[j] * width / 2;
+        airy[j] = (j == 0) ? 1.0 : abs(2 * gsl_sf_bessel_J1(x) / x);
+        sinc[j] = (j == 0) ? 1.0 : abs(sin(u) / u);
+    }
+
+    // name, result on the grid, interpolated, and the exact one
+    vector<tuple<const char *, ValueError<double>, ValueError<double>, double>> cases = {
+        make_tuple("airy min", grid_first_min(airy, ps), interpolate_first_min(airy, ps), 3.8317059702 / radius),
+        make_tuple("airy half power", grid_half_power(airy, ps), interpolate_half_power(airy, ps), 1.6163399479 / radius),
+        make_tuple("sinc min", grid_first_min(sinc, ps), interpolate_first_min(sinc, ps), 2 * M_PI / width),
+        make_tuple("sinc half power", grid_half_power(sinc, ps), interpolate_half_power(sinc, ps), 2 * 1.3915573507 / width)
+    };
+    for(auto &c : cases) {
+        ValueError<double> grid = get<1>(c), interp = get<2>(c);
+        double exact = get<3>(c);
+        if(verbose) printf("\n%s: exact %f, grid %f +- %f, interpolated %f +- %f", get<0>(c), exact, grid.val, grid.err, interp.val, interp.err);
+        // much closer than the grid, and the error estimate not far off
+        if(abs(interp.val - exact) > grid.err / 20 || abs(interp.val - exact) > 2 * interp.err + EPS) {
+            printf("FAILED: %s is %f +- %f, not %f\n", get<0>(c), interp.val, interp.err, exact);
+            return;
+        }
+    }
+
+    // at the end of the values there is nothing to fit, so it's the grid point
+    vector<double> falling = {1.0, 0.9, 0.8};
+    ValueError<double> end = interpolate_first_min(falling, ps), grid_end = grid_first_min(falling, ps);
+    if(end.val != grid_end.val || end.err != grid_end.err) {
+        printf("FAILED: at the end, %f +- %f\n", end.val, end.err);
+        return;
+    }
+    printf("OK\n");
+}
+
+void test_philox(bool verbose = false) {
+    printf("test_philox : ");
+
+    // known answers from the Random123 test vectors
+    vector<array<uint32_t, 6>> inputs = {
+        {0, 0, 0, 0, 0, 0},
+        {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+        {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0xa4093822, 0x299f31d0}};
+    vector<array<uint32_t, 4>> outputs = {
+        {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+        {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+        {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}};
+
+    for(unsigned int k = 0; k < inputs.size(); k ++ ) {
+        array<uint32_t, 6> in = inputs[k];
+        array<uint32_t, 4> out = philox4x32({in[0], in[1], in[2], in[3]}, {in[4], in[5]});
+        if(out != outputs[k]) {
+            if(verbose) printf("\ngot %08x %08x %08x %08x", out[0], out[1], out[2], out[3]);
+            printf("FAILED for vector %u\n", k);
+            return;
+        }
+    }
+
+    // the random aperture must not depend on how many threads drew it
+    int nx = 37, ny = 40;
+    vector<double> xs = coords(10.0, ny), ys = coords(10.0, nx);
+    vector<double> params = {4.0, 3.0, 1.0, 0.5, 42};
+    Array2d one(nx, ny), many(nx, ny);
+
+    GeneratorSettings saved = gen_settings;
+    gen_settings = {true, 1, false};
+    generators.at("rand_errors").gen(one, xs, ys, params);
+    gen_settings = {true, 3, false};
+    generators.at("rand_errors").gen(many, xs, ys, params);
+    gen_settings = saved;
+
+    if(!(one == many)) {
+        printf("FAILED: different with 3 threads\n");
+        return;
+    }
+
+    // and the numbers should look like a standard normal distribution
+    int n = 100000;
+    double sum = 0, sum_sq = 0;
+    for(int i = 0; i < n; i ++ ) {
+        double g = philox_gaussian(7, 0, i / 300, i % 300);
+        sum += g;
+        sum_sq += g * g;
+    }
+    double mean = sum / n, var = sum_sq / n - mean * mean;
+    if(verbose) printf("\nmean %f variance %f ", mean, var);
+    if(abs(mean) > 0.02 || abs(var - 1.0) > 0.02) {
+        printf("FAILED: mean %f variance %f\n", mean, var);
+        return;
+    }
+    printf("OK\n");
+}
+
+void test_analysis_engine(bool verbose = false) {
+    printf("test_analysis_engine : ");
+
+    // the fused sweeps must give exactly what the separate functions give,
+    // for a full spectrum and for the half spectrum of a real aperture
+    // an odd number of columns, so the half spectrum has no Nyquist column
+    int nx = 24, ny = 25;
+    vector<double> xs = coords(10.0, ny), ys = coords(10.0, nx);
+    vector<double> ps = fftfreq(ny, 10.0/ny/(2*M_PI)), qs = fftfreq(nx, 10.0/nx/(2*M_PI));
+    vector<double> params = {3.0, 2.0, 0.7, 0.3, 5};
+    AnalysisEngine engine({"find_min", "fwhp", "fwhp_y", "central_amplitude", "in_phase_stat", "print_in_abs", "out_lims"}, 0.0, 0.2);
+
+    Array2d in(nx, ny), out(nx, ny), half(nx, ny/2 + 1), image(nx, ny);
+    RealArray2d real_in(nx, ny);
+    generators.at("rand_errors").gen(in, xs, ys, params);
+    generators.at("gaussian_hole").real_gen(real_in, xs, ys, params);
+    fftw_plan plan = fftw_plan_dft_2d(nx, ny, in.ptr(), out.ptr(), FFTW_FORWARD, FFTW_ESTIMATE);
+    fftw_plan plan_r2c = fftw_plan_dft_r2c_2d(nx, ny, real_in.ptr(), half.ptr(), FFTW_ESTIMATE);
+    fftw_execute(plan);
+    fftw_execute(plan_r2c);
+    fftw_destroy_plan(plan);
+    fftw_destroy_plan(plan_r2c);
+
+    for(int k = 0; k < 2; k ++ ) {
+        ShapeResults res;
+        Array2d &spectrum = (k == 0) ? out : half;
+        if(k == 0) engine.analyse_in(in, xs, ys, params[0], res);
+        else engine.analyse_in(real_in, xs, ys, params[0], res);
+        engine.analyse_out(spectrum, ny, ps, qs, res);
+
+        ValueError<double> phase = (k == 0) ? mean_stddev(myarg, in, xs, ys, params[0]) : mean_stddev(myarg, real_in, xs, ys, params[0]);
+        Limits in_lims = (k == 0) ? in.find_interesting(myabs, 0.0, 0.2) : real_in.find_interesting(myabs, 0.0, 0.2);
+        ValueError<double> first_min = find_first_min(myabs, spectrum, ps);
+        ValueError<double> fwhp = hwhp(spectrum, ps), fwhp_y = hwhp(spectrum, qs, true);
+        double central = abs(spectrum(0, 0));
+        if(k == 0) out.copy_into(image);
+        else expand_hermitian(half, image);
+        fftshift(image);
+        Limits out_lims = image.find_interesting(myabs, 0.0, 0.2);
+
+        if(verbose) printf("\nout limits %s, expected %s", lims_to_str(res.out_lims).c_str(), lims_to_str(out_lims).c_str());
+        if(res.in_lims != in_lims || res.out_lims != out_lims
+                || res.first_min.val != first_min.val || res.fwhp.val != fwhp.val || res.fwhp_y.val != fwhp_y.val
+                || res.central_amplitude != central || res.in_phase.val != phase.val || res.in_phase.err != phase.err) {
+            printf("FAILED for %s spectrum\n", (k == 0) ? "full" : "half");
+            return;
+        }
+    }
+    printf("OK\n");
+}
+
+void test_radial(bool verbose = false) {
+    printf("test_radial : ");
+
+    // the Hankel transform of a circle is the Airy pattern, and its centre is the area
+    vector<double> ps = fftfreq(128, 50.0 / 128 / (2*M_PI));
+    vector<double> circle = {3.0};
+    vector<string> tasks = {"find_min", "fwhp", "fwhp_y", "central_amplitude"};
+    AnalysisEngine interp_engine(tasks, 0.0, 0.0, true);
+    ShapeProperties sp{"circular", 50.0, 50.0, circle};
+    ShapeResults res, exact;
+    interp_engine.analyse_radial(radial_generators.at("circular"), circle, 1.0, ps, ps, res);
+    analytic_results(sp, exact);
+    if(verbose) printf("\nmin %f (%f), half power %f (%f), centre %f", res.first_min.val, exact.first_min.val, res.fwhp.val, exact.fwhp.val, res.central_amplitude);
+    // as close as interpolating the exact pattern gets, in test_subgrid
+    auto off = [&](const ValueError<double> &r, const ValueError<double> &e) {
+        return abs(r.val - e.val) > ps[1] / 20 || abs(r.val - e.val) > 2 * r.err + EPS;
+    };
+    if(off(res.first_min, exact.first_min) || off(res.fwhp, exact.fwhp) || off(res.fwhp_y, exact.fwhp_y)
+            || abs(res.central_amplitude - M_PI * 9.0) > 1e-9) {
+        printf("FAILED for the circle\n");
+        return;
+    }
+
+    // and it has to give the same grid points as the FFT of the apertures on the grid,
+    // with the centre as close as the pixels allow
+    int n = 256;
+    double l = 50.0;
+    vector<double> xs = coords(l, n), fs = fftfreq(n, l/n/(2*M_PI));
+    AnalysisEngine engine(tasks, 0.0, 0.0);
+    RealArray2d in(n, n);
+    Array2d half(n, n/2 + 1);
+    fftw_plan plan = fftw_plan_dft_r2c_2d(n, n, in.ptr(), half.ptr(), FFTW_ESTIMATE);
+    vector<pair<string, vector<double>>> shapes = {{"circular", {4.0}}, {"gaussian", {5.0, 3.0}}, {"gaussian_hole", {5.0, 3.0, 1.0}}};
+    for(auto &shape : shapes) {
+        generators.at(shape.first).real_gen(in, xs, xs, shape.second);
+        fftw_execute_dft_r2c(plan, in.ptr(), half.ptr());
+        ShapeResults fft_res, radial_res;
+        engine.analyse_out(half, n, fs, fs, fft_res);
+        engine.analyse_radial(radial_generators.at(shape.first), shape.second, n * n / (l * l), fs, fs, radial_res);
+
+        double central_diff = abs(radial_res.central_amplitude / fft_res.central_amplitude - 1.0);
+        if(verbose) printf("\n%s: min %f %f, centre off by %g", shape.first.c_str(), fft_res.first_min.val, radial_res.first_min.val, central_diff);
+        if(fft_res.first_min.val != radial_res.first_min.val || fft_res.fwhp.val != radial_res.fwhp.val
+                || fft_res.fwhp_y.val != radial_res.fwhp_y.val || central_diff > 0.01) {
+            printf("FAILED for %s\n", shape.first.c_str());
+            fftw_destroy_plan(plan);
+            return;
+        }
+    }
+    fftw_destroy_plan(plan);
+    printf("OK\n");
+}
+
+void test_mask_spectrum(bool verbose = false) {
+    printf("test_mask_spectrum : ");
+
+    // the analytic transfer function must match the transformed mask, for even
+    // (modulated) and odd sizes, when lc is well between the spacing and the size
+    for(int n : {64, 63}) {
+        vector<double> xs = coords(64.0, n), ys = coords(60.0, n);
+        double lc = 4.0;
+        bool modulate = (n % 2 == 0);
+        shared_ptr<const Array2d> fft_spec = mask_spectrum(xs, ys, lc, modulate, false);
+        shared_ptr<const Array2d> analytic = mask_spectrum(xs, ys, lc, modulate, true);
+
+        double max_diff = 0.0, max_val = 0.0;
+        for(int i = 0; i < n; i ++ )
+            for(int j = 0; j < n; j ++ ) {
+                max_diff = max(max_diff, abs((*fft_spec)(i, j) - (*analytic)(i, j)));
+                max_val = max(max_val, abs((*fft_spec)(i, j)));
+            }
+        if(verbose) printf("\nn = %d: max difference %g of %g", n, max_diff, max_val);
+        if(max_diff > 1e-9 * max_val) {
+            printf("FAILED for n = %d\n", n);
+            return;
+        }
+
+        // and the same one again comes from the cache
+        if(mask_spectrum(xs, ys, lc, modulate, false) != fft_spec) {
+            printf("FAILED: not cached\n");
+            return;
+        }
+    }
+    printf("OK\n");
+}
+
+/** Correlation of the phase of a with itself d columns away, within radius */
+double phase_correlation(Array2d &a, const vector<double> &xs, const vector<double> &ys, double radius, int d) {
+    double sum_prod = 0, sum_sq = 0;
+    for(unsigned int i = 0; i < ys.size(); i ++ )
+        for(unsigned int j = 0; j + d < xs.size(); j ++ ) {
+            double rsq = xs[j] * xs[j] + ys[i] * ys[i];
+            double rsq_d = xs[j+d] * xs[j+d] + ys[i] * ys[i];
+            if(rsq < radius * radius && rsq_d < radius * radius) {
+                sum_prod += arg(a(i, j)) * arg(a(i, j+d));
+                sum_sq += arg(a(i, j)) * arg(a(i, j));
+            }
+        }
+    return sum_prod / sum_sq;
+}
+
+void test_spectral_errors(bool verbose = false) {
+    printf("test_spectral_errors : ");
+
+    // the spectral errors should have the same correlation as the convolved ones,
+    // which for a gaussian mask of length lc is exp(-d^2 / (4 lc^2)) at distance d.
+    // One seed's correlation is off by about 0.06, so the average over many of them
+    // is compared, to within 3 standard errors of that average
+    int n = 64, n_seeds = 64, d = 3;
+    vector<double> xs = coords(64.0, n), ys = coords(64.0, n);
+    double radius = 20.0, lc = 3.0;
+    Array2d in(n, n);
+
+    double corr_conv = 0, corr_spectral = 0, sq_conv = 0, sq_spectral = 0;
+    for(int seed = 1; seed <= n_seeds; seed ++ ) {
+        vector<double> params = {radius, 1000.0, 0.0, 0.5, (double)seed, lc};
+        generators.at("corr_errors").gen(in, xs, ys, params);
+        double c = phase_correlation(in, xs, ys, radius, d);
+        corr_conv += c / n_seeds;
+        sq_conv += c * c / n_seeds;
+        generators.at("corr_errors_spectral").gen(in, xs, ys, params);
+        c = phase_correlation(in, xs, ys, radius, d);
+        corr_spectral += c / n_seeds;
+        sq_spectral += c * c / n_seeds;
+
+        // the imaginary part of the depth must have been negligible
+        ValueError<double> stat = mean_stddev(myarg, in, xs, ys, radius);
+        if(abs(stat.err - 0.5) > 1e-6) {
+            printf("FAILED: RMS %f instead of 0.5\n", stat.err);
+            return;
+        }
+    }
+    double se_conv = sqrt((sq_conv - corr_conv * corr_conv) / (n_seeds - 1));
+    double se_spectral = sqrt((sq_spectral - corr_spectral * corr_spectral) / (n_seeds - 1));
+
+    double expected = exp(-d * d / (4 * lc * lc));
+    if(verbose) printf("\ncorrelation at %d: convolved %f +- %f, spectral %f +- %f, expected %f ", d, corr_conv, se_conv, corr_spectral, se_spectral, expected);
+    if(se_spectral > 0.01 || abs(corr_spectral - expected) > 3 * se_spectral
+        || abs(corr_conv - corr_spectral) > 3 * sqrt(se_conv * se_conv + se_spectral * se_spectral)) {
+        printf("FAILED: correlation %f +- %f vs %f +- %f\n", corr_spectral, se_spectral, corr_conv, se_conv);
+        return;
+    }
+    printf("OK\n");
+}
+
+void test_single_precision(bool verbose = false) {
+    printf("test_single_precision : ");
+
+    // the same apertures in single precision should give the same results,
+    // to within float rounding: a real one and a complex one
+    int n = 128;
+    vector<double> xs = coords(64.0, n), ys = coords(64.0, n);
+    vector<double> ps = fftfreq(n, 0.5/(2*M_PI)), qs = ps;
+    AnalysisEngine engine({"find_min", "fwhp", "fwhp_y", "central_amplitude"}, 0.0, 0.0);
+
+    for(string key : {"gaussian_hole", "rand_errors"}) {
+        vector<double> params = {20.0, 15.0, 4.0, 0.3, 5.0};
+        ShapeResults dbl, sgl;
+
+        Array2d in(n, n), out(n, n);
+        Array2df in_f(n, n), out_f(n, n);
+        fftw_plan plan = shared_plan(n, n, FFTW_FORWARD, in.ptr(), out.ptr());
+        fftwf_plan plan_f = shared_plan(n, n, FFTW_FORWARD, in_f.ptr(), out_f.ptr());
+        generators.at(key).gen(in, xs, ys, params);
+        generators_f.at(key).gen(in_f, xs, ys, params);
+        execute_dft(plan, in.ptr(), out.ptr());
+        execute_dft(plan_f, in_f.ptr(), out_f.ptr());
+        engine.analyse_out(out, n, ps, qs, dbl);
+        engine.analyse_out(out_f, n, ps, qs, sgl);
+
+        double rel = abs(sgl.central_amplitude - dbl.central_amplitude) / dbl.central_amplitude;
+        if(verbose) printf("\n%s: find_min %f %f, fwhp %f %f, central rel diff %g", key.c_str(),
+            dbl.first_min.val, sgl.first_min.val, dbl.fwhp.val, sgl.fwhp.val, rel);
+        if(dbl.first_min.val != sgl.first_min.val || dbl.fwhp.val != sgl.fwhp.val
+                || dbl.fwhp_y.val != sgl.fwhp_y.val || rel > 1e-5) {
+            printf("FAILED for %s\n", key.c_str());
+            return;
+        }
+    }
     printf("OK\n");
 }
 
@@ -219,6 +1231,26 @@ int main() {
     test_array2d_equality();
     test_array2d_deepcopy(false);
     test_array2d_fftshift(false);
+    test_inplace_fftshift(false);
+    test_projections(false);
     test_find_interesting(false);
+    test_scheduler(false);
+    test_shards(false);
+    test_ordered_writer(false);
+    test_journal(false);
+    test_sweeps(false);
+    test_trace(false);
+    test_expand_hermitian(false);
+    test_pruned_dft(false);
+    test_tiled_dft(false);
+    test_zoom_dft(false);
+    test_row_spans(false);
+    test_subgrid(false);
+    test_philox(false);
+    test_analysis_engine(false);
+    test_radial(false);
+    test_mask_spectrum(false);
+    test_spectral_errors(false);
+    test_single_precision(false);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "trace.h"
+
+#include<cstdio>
+#include<cmath>
+#include<map>
+#include<algorithm>
+
+Tracer tracer;
+
+// the worker and shape of the spans of each thread. The main thread and the
+// threads the generators start themselves are not a worker, and have no shape
+thread_local int trace_worker = -1;
+thread_local long trace_shape = -1;
+
+void trace_context(int worker, long shape) {
+    trace_worker = worker;
+    trace_shape = shape;
+}
+
+Tracer::Tracer() : on(false) {}
+
+void Tracer::enable() {
+    t0 = chrono::steady_clock::now();
+    on = true;
+}
+
+double Tracer::now() const {
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+}
+
+void Tracer::add(const char * name, double start, double end) {
+    lock_guard<mutex> lock(mtx);
+    events.push_back(TraceEvent{name, trace_worker, trace_shape, start, end - start});
+}
+
+bool Tracer::write_chrome(const string &filename) {
+    lock_guard<mutex> lock(mtx);
+    FILE * filep = fopen(filename.c_str(), "w");
+    if(filep == NULL) return false;
+
+    // thread 0 is everything outside the workers, and worker k is thread k + 1
+    int max_worker = -1;
+    for(const TraceEvent &e : events)
+        max_worker = max(max_worker, e.worker);
+
+    fprintf(filep, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(filep, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"main\"}}");
+    for(int w = 0; w <= max_worker; w ++ )
+        fprintf(filep, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"work_%d\"}}", w + 1, w);
+    for(const TraceEvent &e : events)
+        fprintf(filep, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"shape\": %ld}}",
+            e.name, e.worker + 1, e.start, e.dur, e.shape);
+    fprintf(filep, "\n]}\n");
+
+    bool ok = (ferror(filep) == 0);
+    return (fclose(filep) == 0) && ok;
+}
+
+string Tracer::summary() {
+    lock_guard<mutex> lock(mtx);
+
+    // the times of every stage, in ms
+    map<string, vector<double>> times;
+    for(const TraceEvent &e : events)
+        times[e.name].push_back(e.dur / 1000.0);
+
+    // most of the time first
+    vector<pair<double, string>> order;
+    for(auto &t : times) {
+        sort(t.second.begin(), t.second.end());
+        double total = 0.0;
+        for(double d : t.second) total += d;
+        order.push_back(make_pair(total, t.first));
+    }
+    sort(order.rbegin(), order.rend());
+
+    // the nearest-rank percentile of sorted values
+    auto percentile = [](const vector<double> &v, double pc) {
+        int rank = (int)ceil(pc / 100.0 * v.size());
+        return v[max(rank, 1) - 1];
+    };
+
+    char buff[200];
+    sprintf(buff, "%-20s %8s %12s %10s %10s %10s\n", "stage", "count", "total_ms", "p50_ms", "p95_ms", "max_ms");
+    string table = buff;
+    for(const pair<double, string> &o : order) {
+        const vector<double> &v = times[o.second];
+        sprintf(buff, "%-20s %8zu %12.3f %10.3f %10.3f %10.3f\n", o.second.c_str(), v.size(), o.first,
+            percentile(v, 50), percentile(v, 95), v.back());
+        table += buff;
+    }
+    return table;
+}
@@ -0,0 +1,92 @@
+#ifndef TRACE
+#define TRACE
+
+#include<string>
+#include<vector>
+#include<mutex>
+#include<chrono>
+
+using namespace std;
+
+/** One timed stage of the work on a shape: its name, the worker that did it and the
+ * shape it was for (-1 if it wasn't done by a worker or for a shape), and when it
+ * started and how long it took, in microseconds from when tracing was turned on.
+ */
+struct TraceEvent {
+    const char * name;
+    int worker;
+    long shape;
+    double start, dur;
+};
+
+
+/** Collects the timed stages of a run from all threads, to be written out at the end
+ * as a Chrome trace, and summed up per stage. Until it's enabled, it doesn't even look
+ * at the clock, so the spans can stay in the code for every run.
+ */
+class Tracer {
+private:
+    bool on;
+    chrono::steady_clock::time_point t0;
+    mutex mtx;
+    vector<TraceEvent> events;
+
+public:
+    Tracer();
+
+    /** Start recording. Only call it before any other thread is started */
+    void enable();
+    bool enabled() const { return on; }
+
+    /** microseconds since enable() */
+    double now() const;
+    /** Record the stage name, for the worker and shape set with trace_context in this thread */
+    void add(const char * name, double start, double end);
+
+    /**
+     * Write the events in the Chrome trace event format, which Perfetto and chrome://tracing
+     * load: one track per worker, with the shape index in the arguments of every event.
+     * Returns false if the file can't be written.
+     */
+    bool write_chrome(const string &filename);
+
+    /**
+     * A table of the stages, with how many times each was done, and the total, median, 95th
+     * percentile and longest of the times they took, in ms. The spans nest (e.g. fft within
+     * corr_errors within generate), so the totals add up to more than the run took.
+     */
+    string summary();
+};
+
+/** The tracer of the program */
+extern Tracer tracer;
+
+/** Set the worker and shape that the spans of this thread are for, from here on */
+void trace_context(int worker, long shape);
+
+
+/** Times the scope it lives in, and adds it to the tracer at the end, as the stage name.
+ * name must be a string literal, since only the pointer is kept.
+ */
+class TraceSpan {
+private:
+    const char * name;
+    double start;
+
+public:
+    TraceSpan(const char * name) : name(name), start(tracer.enabled() ? tracer.now() : 0.0) {}
+    ~TraceSpan() {
+        if(tracer.enabled()) tracer.add(name, start, tracer.now());
+    }
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan& operator=(const TraceSpan &) = delete;
+};
+
+/** Call f() in a span called name, and return what it returns */
+template <typename F>
+auto traced(const char * name, F f) {
+    TraceSpan span(name);
+    return f();
+}
+
+#endif
@@ -3,11 +3,6 @@
 // define the mutex
 mutex planner_mtx;
 
-complex_to_real myabs = [](complex<double> z) -> double {return abs(z);};
-complex_to_real myarg = [](complex<double> z) -> double {return arg(z);};
-complex_to_real myre = [](complex<double> z) -> double {return real(z);};
-complex_to_real complexness = [](complex<double> z) -> double {return abs(imag(z)/real(z));};
-
 
 bool contains(const vector<string> &v, const char * s) {
     string str = string(s);
@@ -20,12 +15,9 @@ bool any_begins_with(const vector<string> &v, const char * s) {
 }
 
 
-#define OPTION_ERROR "Incorrect option. Expected %s, got %s"
-
+// readname can be a whole sweep from the config file, so the message is built as a string
 inline void option_error(const char * optname, const char * readname) {
-    char msg[100];
-    sprintf(msg, OPTION_ERROR, optname, readname);
-    throw runtime_error(msg);
+    throw runtime_error(string("Incorrect option. Expected ") + optname + ", got " + readname);
 }
 
 /** Overloaded utility function used to parse one line of the the config file
@@ -89,6 +81,154 @@ void read_option(FILE * filep, const char * optname, vector<string> &option) {
     }
 }
 
+/** Read an option that is allowed to be missing from the config file.
+ * If the next `name = value` line in the file has name optname, it is read into
+ * option and true is returned. Otherwise nothing is consumed and option is left alone.
+ */
+template <typename T>
+bool read_optional(FILE * filep, const char * optname, T &option) {
+    char readname[64];
+    long pos = ftell(filep);
+    bool found = (fscanf(filep, " %63s", readname) == 1 && strcmp(readname, optname) == 0);
+    fseek(filep, pos, SEEK_SET);
+
+    if(found) read_option(filep, optname, option);
+    return found;
+}
+
+/** Parse one of the params of a shape, which can be a plain number, a range
+ * first:last:n, a list a,b,c or a seed stream seed+
+ */
+SweepParam parse_param(const string &token) {
+    SweepParam param;
+    char * end;
+    const char * tok = token.c_str();
+    bool ok = true;
+
+    if(token.back() == '+') {
+        param.seed = true;
+        param.first = strtod(tok, &end);
+        ok = (end == tok + token.size() - 1);
+    }
+    else if(token.find(':') != string::npos) {
+        int n_read = 0;
+        ok = (sscanf(tok, "%lf:%lf:%u%n", &param.first, &param.last, &param.n, &n_read) == 3
+            && n_read == (int)token.size() && param.n > 0);
+    }
+    else if(token.find(',') != string::npos) {
+        size_t begin = 0;
+        while(ok && begin <= token.size()) {
+            size_t comma = min(token.find(',', begin), token.size());
+            string item = token.substr(begin, comma - begin);
+            param.list.push_back(strtod(item.c_str(), &end));
+            ok = !item.empty() && (end == item.c_str() + item.size());
+            begin = comma + 1;
+        }
+        param.n = param.list.size();
+    }
+    else {
+        param.first = strtod(tok, &end);
+        ok = (end == tok + token.size());
+    }
+
+    if(!ok) option_error("params = numbers, ranges first:last:n, lists a,b,c or seeds seed+", tok);
+    return param;
+}
+
+/** Read the params of a shape, which can be sweeps, up to the end of the line */
+void read_option(FILE * filep, const char * optname, vector<SweepParam> &option) {
+    char readname[64];
+    fscanf(filep, " %s =", readname);
+
+    if(strcmp(readname, optname) != 0) option_error(optname, readname);
+
+    string line;
+    for(int c = fgetc(filep); c != EOF && c != '\n'; c = fgetc(filep))
+        line += (char)c;
+
+    size_t begin = line.find_first_not_of(" \t\r");
+    while(begin != string::npos) {
+        size_t end = min(line.find_first_of(" \t\r", begin), line.size());
+        option.push_back(parse_param(line.substr(begin, end - begin)));
+        begin = line.find_first_not_of(" \t\r", end);
+    }
+}
+
+/** The i-th of the values a param takes. For a seed stream, i is the shape's place in the sweep */
+double SweepParam::value(unsigned int i) const {
+    if(seed) return first + i;
+    if(!list.empty()) return list[i];
+    if(n == 1) return first;
+    return first + (last - first) * i / (n - 1);
+}
+
+/** Number of shapes in the sweep */
+unsigned long long ShapeSweep::size() const {
+    unsigned long long total = repeat;
+    for(const SweepParam &param : params)
+        if(!param.seed) total *= param.n;
+    return total;
+}
+
+/** The i-th shape of the sweep, from 0 to size() - 1 */
+ShapeProperties ShapeSweep::shape(unsigned int i) const {
+    ShapeProperties sp;
+    sp.generator_key = generator_key;
+    sp.lx = lx;
+    sp.ly = ly;
+    sp.shape_params.resize(params.size());
+
+    // take i apart into the place of each param in its values, last param first
+    unsigned int rest = i / repeat;
+    for(unsigned int ip = params.size(); ip -- > 0; ) {
+        if(params[ip].seed) {
+            sp.shape_params[ip] = params[ip].value(i);
+            continue;
+        }
+        sp.shape_params[ip] = params[ip].value(rest % params[ip].n);
+        rest /= params[ip].n;
+    }
+    return sp;
+}
+
+void ShapeList::add(const ShapeSweep &sweep) {
+    if(n_shapes + sweep.size() > UINT_MAX)
+        option_error("n_shapes = fewer than 2^32 shapes", to_string(n_shapes + sweep.size()).c_str());
+    sweeps.push_back(sweep);
+    starts.push_back(n_shapes);
+    n_shapes += sweep.size();
+}
+
+unsigned int ShapeList::size() const {
+    return n_shapes;
+}
+
+/** Make shape number idx, from the sweep it's in */
+ShapeProperties ShapeList::operator[](unsigned int idx) const {
+    unsigned int is = upper_bound(starts.begin(), starts.end(), idx) - starts.begin() - 1;
+    return sweeps[is].shape(idx - starts[is]);
+}
+
+/** Whether any of the shapes has the given aperture type */
+bool ShapeList::has_type(const char * generator_key) const {
+    return any_of(sweeps.begin(), sweeps.end(),
+        [&](const ShapeSweep &sweep) { return sweep.generator_key == generator_key; });
+}
+
+unsigned int ShapeList::n_sweeps() const {
+    return sweeps.size();
+}
+
+/** Sweep number is, in the order of the config file */
+const ShapeSweep& ShapeList::sweep(unsigned int is) const {
+    return sweeps[is];
+}
+
+/** Index of the first shape of sweep number is */
+unsigned int ShapeList::sweep_start(unsigned int is) const {
+    return starts[is];
+}
+
 /** 
  * Parse configuration file `filename` and construct the Config object.
  */
@@ -106,17 +246,98 @@ Config::Config(const char * filename) {
     read_option(cnf_filep, "tasks", tasks);
     read_option(cnf_filep, "rel_sens", rel_sens);
     read_option(cnf_filep, "abs_sens", abs_sens);
+
+    // the optional settings can come in any order, but before n_shapes
+    bool more_options = true;
+    while(more_options) {
+        more_options = read_optional(cnf_filep, "print_format", print_format)
+            || read_optional(cnf_filep, "fft_mode", fft_mode)
+            || read_optional(cnf_filep, "rng", rng)
+            || read_optional(cnf_filep, "gen_threads", gen_threads)
+            || read_optional(cnf_filep, "corr_mask", corr_mask)
+            || read_optional(cnf_filep, "precision", precision)
+            || read_optional(cnf_filep, "storage", storage)
+            || read_optional(cnf_filep, "scratch_dir", scratch_dir)
+            || read_optional(cnf_filep, "tile_mb", tile_mb)
+            || read_optional(cnf_filep, "zoom_window", zoom_window)
+            || read_optional(cnf_filep, "zoom_points", zoom_points)
+            || read_optional(cnf_filep, "estimate", estimate)
+            || read_optional(cnf_filep, "radial", radial);
+    }
+    if(print_format != "txt" && print_format != "npy" && print_format != "npy64")
+        option_error("print_format = txt, npy or npy64", print_format.c_str());
+    if(fft_mode != "full" && fft_mode != "pruned")
+        option_error("fft_mode = full or pruned", fft_mode.c_str());
+    if(rng != "gsl" && rng != "philox")
+        option_error("rng = gsl or philox", rng.c_str());
+    if(gen_threads < 1)
+        option_error("gen_threads = a positive integer", to_string(gen_threads).c_str());
+    if(corr_mask != "fft" && corr_mask != "analytic")
+        option_error("corr_mask = fft or analytic", corr_mask.c_str());
+    if(precision != "double" && precision != "single" && precision != "compare")
+        option_error("precision = double, single or compare", precision.c_str());
+    if(storage != "memory" && storage != "mmap")
+        option_error("storage = memory or mmap", storage.c_str());
+    if(tile_mb < 1)
+        option_error("tile_mb = a positive integer", to_string(tile_mb).c_str());
+    if(zoom_window < 0.0)
+        option_error("zoom_window = 0, or a positive number", to_string(zoom_window).c_str());
+    if(zoom_points < 2)
+        option_error("zoom_points = an integer from 2 up", to_string(zoom_points).c_str());
+    if(estimate != "grid" && estimate != "interpolate" && estimate != "validate")
+        option_error("estimate = grid, interpolate or validate", estimate.c_str());
+    if(radial != "off" && radial != "auto")
+        option_error("radial = off or auto", radial.c_str());
+    if(scratch_dir.empty()) {
+        size_t slash = out_prefix.rfind('/');
+        scratch_dir = (slash == string::npos) ? "." : out_prefix.substr(0, max(slash, (size_t)1));
+    }
+
     read_option(cnf_filep, "n_shapes", n_shapes);
 
-    for(int i = 0; i < n_shapes; i ++ ) {
-        ShapeProperties sp;
-        read_option(cnf_filep, "type", sp.generator_key);
-        read_option(cnf_filep, "lx", sp.lx);
-        read_option(cnf_filep, "ly", sp.ly);
-        read_option(cnf_filep, "params", sp.shape_params);
+    // n_shapes counts the shapes, so a sweep counts as all the shapes it makes
+    while((int)shapes.size() < n_shapes) {
+        ShapeSweep sweep;
+        read_option(cnf_filep, "type", sweep.generator_key);
+        read_option(cnf_filep, "lx", sweep.lx);
+        read_option(cnf_filep, "ly", sweep.ly);
+        read_option(cnf_filep, "params", sweep.params);
+
+        int repeat = 1;
+        read_optional(cnf_filep, "repeat", repeat);
+        if(repeat < 1)
+            option_error("repeat = a positive integer", to_string(repeat).c_str());
+        sweep.repeat = repeat;
+
+        shapes.add(sweep);
+    }
+    if((int)shapes.size() != n_shapes)
+        option_error(("n_shapes = " + to_string(shapes.size()) + ", the number of shapes in the sweeps").c_str(),
+            to_string(n_shapes).c_str());
+    fclose(cnf_filep);
+}
+
+string data_filename(const string &prefix, const string &name, unsigned int k, unsigned int n_shards) {
+    if(n_shards <= 1) return prefix + name + ".txt";
+    return prefix + name + "_shard" + to_string(k) + "of" + to_string(n_shards) + ".txt";
+}
+
+string file_hash(const string &filename) {
+    FILE * filep = fopen(filename.c_str(), "rb");
+    if(filep == NULL)
+        throw runtime_error("Could not open " + filename);
 
-        shapes.push_back(sp);
+    unsigned long long hash = 14695981039346656037ULL;
+    int c;
+    while((c = fgetc(filep)) != EOF) {
+        hash ^= (unsigned char)c;
+        hash *= 1099511628211ULL;
     }
+    fclose(filep);
+
+    char buff[20];
+    sprintf(buff, "%016llx", hash);
+    return buff;
 }
 
 /** Construct logger that writes to file pointer filep,
@@ -8,7 +8,10 @@
 #include<map>
 #include<algorithm>
 #include<complex>
+#include<cmath>
+#include<climits>
 #include<mutex>
+#include<thread>
 
 using namespace std;
 
@@ -16,16 +19,69 @@ using namespace std;
 #define DBL_EQ(a, b) (abs(a-b) < EPS)
 
 #define CONV_KEY "corr_errors"
+#define SPECTRAL_KEY "corr_errors_spectral"
 
 // a mutex locks thread execution to only allow one thread at a time to access a resource
 // here it's needed because FFTW only allows one thread to plan FFTs at a time
 extern mutex planner_mtx;
 
-/** Type that takes complex argument and returns real number.
- * These are functions such as abs, real, imag, arg, etc...
+/** Projections: what turns an array element into the real number that gets
+ * printed or looked at, such as abs, real, arg, etc...
+ * They are types rather than function pointers, so every loop that takes one is
+ * compiled for it, and the call is inlined. Each has an overload for real elements,
+ * which skips the complex maths. Elements can be in single or double precision,
+ * but the result is always a double.
  */
-using complex_to_real = double (*)(complex<double>);
-extern complex_to_real myabs, myarg, myre, complexness;
+struct Abs {
+    template <typename R> double operator()(complex<R> z) const { return abs(z); }
+    double operator()(double x) const { return abs(x); }
+};
+struct Arg {
+    template <typename R> double operator()(complex<R> z) const { return arg(z); }
+    double operator()(double x) const { return signbit(x) ? M_PI : 0.0; }
+};
+struct Re {
+    template <typename R> double operator()(complex<R> z) const { return real(z); }
+    double operator()(double x) const { return x; }
+};
+struct Complexness {
+    template <typename R> double operator()(complex<R> z) const { return abs(imag(z)/real(z)); }
+    double operator()(double x) const { return (*this)(complex<double>(x)); }
+};
+/** Squared magnitude, abs without the sqrt */
+struct Norm {
+    template <typename R> double operator()(complex<R> z) const { return (double)real(z) * real(z) + (double)imag(z) * imag(z); }
+    double operator()(double x) const { return x * x; }
+};
+
+constexpr Abs myabs{};
+constexpr Arg myarg{};
+constexpr Re myre{};
+constexpr Complexness complexness{};
+constexpr Norm mynorm{};
+
+/** For comparing abs(fun(z)) with thresholds without working it out: key(z) grows
+ * with abs(fun(z)), and to_key and from_key convert thresholds between the two.
+ * For most projections the key is just abs(fun(z)). For Abs it's the squared
+ * magnitude, so the comparisons don't need a sqrt per element. Exact values on a
+ * threshold come out the same either way, but abs and its square are rounded
+ * separately, so an element within a rounding error (about 1e-16 relative) of a
+ * threshold can fall on the other side of it than it would comparing abs.
+ */
+template <typename P>
+struct MagnitudeKey {
+    P fun;
+    template <typename T> double operator()(T z) const { return abs(fun(z)); }
+    double to_key(double m) const { return m; }
+    double from_key(double k) const { return k; }
+};
+template <>
+struct MagnitudeKey<Abs> {
+    Abs fun;
+    template <typename T> double operator()(T z) const { return mynorm(z); }
+    double to_key(double m) const { return m * m; }
+    double from_key(double k) const { return sqrt(k); }
+};
 
 /** Find if s exists in a vector of strings */
 bool contains(const vector<string> &v, const char * s);
@@ -44,14 +100,81 @@ struct ShapeProperties {
     vector<double> shape_params;
 };
 
+/** One of the params of a sweep. It takes n values: evenly spaced from first to last
+ * for a range, the ones in list for a list, or just first. A seed stream is a single
+ * value that goes up by one from each shape of the sweep to the next, so every shape
+ * gets its own seed.
+ */
+struct SweepParam {
+    double first = 0.0, last = 0.0;
+    unsigned int n = 1;
+    vector<double> list;
+    bool seed = false;
+
+    double value(unsigned int i) const;
+};
+
+/** A block of shapes in the config: one aperture type with every combination of the
+ * values of its params, each repeated `repeat` times. Like nested loops, the first
+ * param changes slowest and the repeats fastest. A plain shape is a sweep of one.
+ */
+struct ShapeSweep {
+    string generator_key;
+    double lx, ly;
+    vector<SweepParam> params;
+    unsigned int repeat = 1;
+
+    unsigned long long size() const;
+    ShapeProperties shape(unsigned int i) const;
+};
+
+/** The shapes of a config, made from its sweeps when they're asked for,
+ * so a sweep of any size takes no more memory than its lines in the file.
+ */
+class ShapeList {
+private:
+    vector<ShapeSweep> sweeps;
+    // index of the first shape of each sweep
+    vector<unsigned int> starts;
+    unsigned int n_shapes = 0;
+
+public:
+    void add(const ShapeSweep &sweep);
+    unsigned int size() const;
+    ShapeProperties operator[](unsigned int idx) const;
+    bool has_type(const char * generator_key) const;
+
+    unsigned int n_sweeps() const;
+    const ShapeSweep& sweep(unsigned int is) const;
+    unsigned int sweep_start(unsigned int is) const;
+};
+
 
 /**
  * Struct containing the configuration of the program.
  * nx and ny are the dimensions of the arrays used
  * tasks is the list of things to do with each shape
  * out_prefix is a prefix for the files where to print data
- * shapes is a vector of shapes to process
+ * shapes are the shapes to process, made from the sweeps in the file as they're needed
  * abs_sens and rel_sens are the sensitivities at printing. Use 0 to print everything.
+ * print_format is how arrays are printed: "txt" (default), or "npy"/"npy64" for binary float32/float64
+ * fft_mode is "full" (default) for plain 2D transforms, or "pruned" to skip the rows of zeros around the aperture
+ * rng is the random number generator of the random apertures: "gsl" (default) or the counter-based "philox"
+ *   corr_errors_spectral always uses philox, whatever rng is
+ * gen_threads is the number of threads to draw one random aperture with. Only used with rng = philox.
+ * corr_mask is how corr_errors gets the spectrum of its gaussian mask: "fft" (default) or "analytic"
+ * precision is what the arrays and transforms are done in: "double" (default), "single", or
+ *   "compare" to do every shape in both, and report how far the single precision results are off
+ * storage is where the arrays are kept: "memory" (default), or "mmap" for files in scratch_dir,
+ *   which by default is the directory of out_prefix. Those are transformed a tile of tile_mb MB at a time
+ * zoom_window, if not 0, is the half width of the window around the centre of the image (in the units of
+ *   the data file) that is worked out with a matrix Fourier transform instead of the FFT, on a grid of
+ *   zoom_points from the centre to the edge
+ * estimate is how find_min, fwhp and fwhp_y find their points: "grid" (default) for the nearest grid
+ *   point, "interpolate" in between them, or "validate" to interpolate, and also compare both with the
+ *   analytic results for the apertures that have them
+ * radial is "off" (default), or "auto" to do the radially symmetric apertures with a Hankel transform
+ *   along the radius instead of the FFT, when none of the tasks need the arrays
  * convolution is a flag describing whether a convolution in the input array is needed. If yes, we'll need a second FFT plan for transforming backwards, because convolution is done by multiplying the FFT results.
  */
 struct Config {
@@ -59,13 +182,41 @@ struct Config {
 
     string out_prefix;
     vector<string> tasks;
-    vector<ShapeProperties> shapes;
+    ShapeList shapes;
 
     int nx, ny;
     double abs_sens, rel_sens;
+
+    string print_format = "txt";
+    string fft_mode = "full";
+    string rng = "gsl";
+    int gen_threads = 1;
+    string corr_mask = "fft";
+    string precision = "double";
+    string storage = "memory";
+    string scratch_dir = "";
+    int tile_mb = 256;
+    double zoom_window = 0.0;
+    int zoom_points = 256;
+    string estimate = "grid";
+    string radial = "off";
 };
 
 
+/**
+ * Name of the data file called name (e.g. "dat") for the output prefix. For shard k
+ * of a run split over n_shards > 1 processes, it's the partial file of that shard.
+ */
+string data_filename(const string &prefix, const string &name, unsigned int k = 0, unsigned int n_shards = 1);
+
+/**
+ * A hash of the contents of the file, as 16 hex digits, to tell whether a file has
+ * changed since. It's FNV-1a, so it's the same on every machine, but not cryptographic.
+ * Throws runtime_error if the file can't be read.
+ */
+string file_hash(const string &filename);
+
+
 /**
  * My own utility logger, than can be turned on or off
  * whenever. It writes to the given file pointer, which can
@@ -110,6 +261,23 @@ template <typename T> vector<T> fftshift(const vector<T> &v) {
 }
 
 
+/**
+ * Run fun(begin, end) on n_threads threads, each given one contiguous chunk
+ * [begin, end) of the n rows. Returns when all of them are done.
+ */
+template <typename F> void parallel_rows(int n, int n_threads, F fun) {
+    if(n_threads <= 1 || n <= 1) {
+        fun(0, n);
+        return;
+    }
+    vector<thread> threads;
+    for(int t = 0; t < n_threads; t ++ )
+        threads.push_back(thread(fun, n * t / n_threads, n * (t+1) / n_threads));
+    for(thread &th : threads)
+        th.join();
+}
+
+
 /**
  * Calculate the coordinates of n evenly distributed points between -l/2 and l/2
  */
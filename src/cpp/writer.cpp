@@ -0,0 +1,167 @@
+#include "writer.h"
+
+#include<stdexcept>
+#include<unistd.h>
+
+/** Open filename for writing and start the writer thread */
+OrderedWriter::OrderedWriter(const string &filename) : OrderedWriter(filename, 0) {}
+
+/** Same, for when only the lines from index first on will be pushed */
+OrderedWriter::OrderedWriter(const string &filename, unsigned int first) :
+    next_idx(first), closing(false) {
+    filep = fopen(filename.c_str(), "w");
+    if(filep == NULL)
+        throw runtime_error("Could not open data file " + filename);
+
+    writer_thread = thread(&OrderedWriter::write_loop, this);
+}
+
+OrderedWriter::~OrderedWriter() {
+    close();
+}
+
+/** Hand a line over to the writer. Safe to call from any thread */
+void OrderedWriter::push(const DataLine &dl) {
+    {
+        lock_guard<mutex> lock(mtx);
+        incoming.push(dl);
+    }
+    cv.notify_one();
+}
+
+/** Wait for everything pushed so far to be written, then close the file.
+ * Lines still missing their predecessors are written at the end, in order.
+ */
+void OrderedWriter::close() {
+    if(filep == NULL) return;
+    {
+        lock_guard<mutex> lock(mtx);
+        closing = true;
+    }
+    cv.notify_one();
+    writer_thread.join();
+
+    fclose(filep);
+    filep = NULL;
+}
+
+/** Body of the writer thread: move incoming lines to the reorder buffer,
+ * and write out whatever is contiguous with what's already in the file.
+ */
+void OrderedWriter::write_loop() {
+    bool done = false;
+
+    while(!done) {
+        queue<DataLine> batch;
+        {
+            unique_lock<mutex> lock(mtx);
+            cv.wait(lock, [this]{ return !incoming.empty() || closing; });
+            swap(batch, incoming);
+            done = closing;
+        }
+
+        for(; !batch.empty(); batch.pop())
+            early[batch.front().idx] = batch.front().line;
+
+        while(!early.empty() && early.begin()->first == next_idx) {
+            fprintf(filep, "%s\n", early.begin()->second.c_str());
+            early.erase(early.begin());
+            next_idx++;
+        }
+        fflush(filep);
+    }
+
+    // flush anything left behind by a gap in the indices
+    for(map<unsigned int, string>::iterator it = early.begin(); it != early.end(); it++ )
+        fprintf(filep, "%s\n", it->second.c_str());
+    early.clear();
+}
+
+
+/** Open the journal called filename. Unless resuming, or if there is no journal
+ * yet, start a new one with the given header. When resuming, pick up the records
+ * of the journal that's there, which must have the same header.
+ */
+Journal::Journal(const string &filename, const string &header, bool resume) {
+    if(resume && read(filename, header)) {
+        filep = fopen(filename.c_str(), "a");
+    }
+    else {
+        filep = fopen(filename.c_str(), "w");
+        if(filep != NULL) fprintf(filep, "%s\n", header.c_str());
+    }
+    if(filep == NULL)
+        throw runtime_error("Could not open journal " + filename);
+    fflush(filep);
+}
+
+Journal::~Journal() {
+    close();
+}
+
+/** Read the records of the journal filename into recovered. Returns false if there is
+ * no such file. A record that was cut short when the run was killed is dropped, and
+ * cut off the file so new ones start on a line of their own.
+ */
+bool Journal::read(const string &filename, const string &header) {
+    FILE * in = fopen(filename.c_str(), "r");
+    if(in == NULL) return false;
+
+    char buff[4096];
+    string line;
+    long complete = 0;
+    bool first = true;
+    while(fgets(buff, sizeof(buff), in) != NULL) {
+        line += buff;
+        if(line.back() != '\n') continue;
+        line.pop_back();
+        complete = ftell(in);
+
+        if(first) {
+            if(line != header) {
+                fclose(in);
+                throw runtime_error("Journal " + filename + " is from a different run: " + line);
+            }
+            first = false;
+        }
+        else {
+            size_t space = line.find(' ');
+            string rest = line.substr(space + 1);
+            recovered[line.substr(0, space)][stoul(rest)] = rest;
+        }
+        line.clear();
+    }
+    fclose(in);
+
+    if(first) return false;
+    if(truncate(filename.c_str(), complete) != 0)
+        throw runtime_error("Could not cut the last record off journal " + filename);
+    return true;
+}
+
+/** Whether the previous run recorded the line called name of shape idx */
+bool Journal::has(const string &name, unsigned int idx) const {
+    map<string, map<unsigned int, string>>::const_iterator it = recovered.find(name);
+    return it != recovered.end() && it->second.count(idx) > 0;
+}
+
+/** All the lines called name the previous run recorded, by shape index */
+const map<unsigned int, string>& Journal::lines(const string &name) {
+    return recovered[name];
+}
+
+/** Append the line dl for the data file called name, and make sure it's on the disk
+ * before returning. Safe to call from any thread.
+ */
+void Journal::record(const string &name, const DataLine &dl) {
+    lock_guard<mutex> lock(mtx);
+    fprintf(filep, "%s %s\n", name.c_str(), dl.line.c_str());
+    fflush(filep);
+    fsync(fileno(filep));
+}
+
+void Journal::close() {
+    if(filep == NULL) return;
+    fclose(filep);
+    filep = NULL;
+}
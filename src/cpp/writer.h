@@ -0,0 +1,84 @@
+#ifndef WRITER
+#define WRITER
+
+#include<cstdio>
+#include<string>
+#include<map>
+#include<queue>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+
+using namespace std;
+
+/** This struct holds an index and a string;
+ * It's meant to hold a line of data to be printed to the data file.
+ * The index is the shape index, which decides where the line goes in the file.
+ */
+struct DataLine {
+    unsigned int idx;
+    string line;
+};
+
+
+/** Writes data lines to a file in order of their index, starting from 0,
+ * or from the first index it's given, if it only gets the shapes from there on.
+ * Any thread can push lines in any order. A separate writer thread takes them,
+ * holds on to the ones that arrived early, and appends every line to the file
+ * as soon as all the lines with lower indices are written. So data reaches the
+ * disk while the run is still going, and only the out-of-order lines are kept in memory.
+ */
+class OrderedWriter {
+private:
+    FILE * filep;
+    // index of the next line to write
+    unsigned int next_idx;
+
+    // lines pushed but not yet picked up by the writer thread
+    queue<DataLine> incoming;
+    bool closing;
+    mutex mtx;
+    condition_variable cv;
+
+    // lines that arrived before the ones preceding them. Only touched by the writer thread
+    map<unsigned int, string> early;
+
+    thread writer_thread;
+    void write_loop();
+
+public:
+    OrderedWriter(const string &filename);
+    OrderedWriter(const string &filename, unsigned int first);
+    ~OrderedWriter();
+
+    void push(const DataLine &dl);
+    void close();
+};
+
+
+/** Append-only record of the lines of the shapes that are done, kept next to
+ * the data files so that a run that gets killed can carry on where it stopped.
+ * Every record is one line, "name line", where name says which data file the
+ * line is for, and goes to the disk straight away. The first line is a header
+ * saying what run the journal belongs to.
+ */
+class Journal {
+private:
+    FILE * filep;
+    mutex mtx;
+    // records left by the previous run, by name, then by shape index
+    map<string, map<unsigned int, string>> recovered;
+
+    bool read(const string &filename, const string &header);
+
+public:
+    Journal(const string &filename, const string &header, bool resume);
+    ~Journal();
+
+    bool has(const string &name, unsigned int idx) const;
+    const map<unsigned int, string>& lines(const string &name);
+    void record(const string &name, const DataLine &dl);
+    void close();
+};
+
+#endif
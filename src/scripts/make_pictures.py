@@ -41,9 +41,10 @@ if __name__ == "__main__":
     # uncomment this to automagically plot everything created by a certain config
     # otherwise do it manually with your own tweaks
     n_shapes, prefix, figs = parse_config("config/errors.txt")
+    ext = image_extension("config/errors.txt")
     for i in range(n_shapes):
         for fig in figs:
-            filename = prefix + str(i) + fig + ".txt"
+            filename = prefix + str(i) + fig + ext
             title = fig.replace("_", " ").replace("in", "mirror").replace("out", "image").replace("abs", "amplitude")
 
             # read the data
@@ -65,6 +66,6 @@ if __name__ == "__main__":
             colour_plot(data, coord_lim, title, colorbar=True, colormap=colormap)
             
             # save the figure
-            figname = filename.replace(".txt", ".png").replace("data/", "")
+            figname = filename.replace(ext, ".png").replace("data/", "")
             plt.savefig(os.path.join(SAVE_DIR, figname), bbox_inches="tight")
         plt.show()
@@ -47,10 +47,30 @@ def parse_config(filename):
     return (n_shapes, prefix, figs)
 
 
+def image_extension(filename):
+    """ The extension of the image files produced by a config: .npy if they are binary, otherwise .txt """
+    with open(filename) as fin:
+        for line in fin:
+            if line.startswith("print_format"):
+                return ".txt" if extract_value(line) == "txt" else ".npy"
+            if line.startswith("n_shapes"):
+                break
+    return ".txt"
+
+
 def read_image(filename):
-    """ Read image from a data file """
+    """ Read image from a data file, either text or binary (.npy) """
     
     print("Reading data from " + filename)
+    if filename.endswith(".npy"):
+        # the limits are in a small text file next to the array
+        with open(filename[:-len(".npy")] + "_lims.txt") as fin:
+            lims = [[float(x) for x in line.split()] for line in fin.readlines()]
+            xlim = lims[0]
+            ylim = lims[1]
+        data = np.load(filename, mmap_mode='r')
+        return xlim, ylim, data
+
     with open(filename) as fin:
         lines = fin.readlines()
         data = [[float(x) for x in line.split()] for line in lines]
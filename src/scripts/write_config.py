@@ -17,6 +17,10 @@ os.makedirs(DATA_DIR, exist_ok=True)
 def write_option(fout, name, value):
     fout.write(PARAM_STR.format(name, value))
 
+# a list of values for one of the params, which the program sweeps over
+def sweep(values):
+    return ",".join("{:.5f}".format(v) for v in values)
+
 ################ change these ################
 FILENAME = "corr_sig.txt"
 
@@ -49,16 +53,17 @@ with open(os.path.join(CONF_DIR, FILENAME), "w") as fout:
     write_option(fout, "abs_sens", ABS_SENS)
     write_option(fout, "n_shapes", N_DIFF_SHAPES * N_REPEAT)
 
-    for s_eps in sigmas:
-        for l_corr in ls:
-            for _ in range(N_REPEAT):
-                fout.write("\n")
-                write_option(fout, "type", TYPE)
-                write_option(fout, "lx", LX)
-                write_option(fout, "ly", LY)
-                ################ and change this: ################
-                r = 6           # telescope radius
-                sig = 3         # taper
-                r_int = 0       # interior hole
-                seed = np.random.randint(1, 32e3)        # rng seed
-                write_option(fout, "params", "{: 5.5f} {: 5.5f} {: 5.5f} {: 5.5f} {:05d} {: 5.5f}".format(r, sig, r_int, s_eps, seed, l_corr))
+    # one sweep over every combination, instead of a block per shape.
+    # The program makes the shapes in the same order as the loops
+    # for s_eps in sigmas: for l_corr in ls: for _ in range(N_REPEAT)
+    fout.write("\n")
+    write_option(fout, "type", TYPE)
+    write_option(fout, "lx", LX)
+    write_option(fout, "ly", LY)
+    ################ and change this: ################
+    r = 6           # telescope radius
+    sig = 3         # taper
+    r_int = 0       # interior hole
+    seed = np.random.randint(1, 32e3)        # first rng seed, then one more for each shape
+    write_option(fout, "params", "{: 5.5f} {: 5.5f} {: 5.5f} {} {:d}+ {}".format(r, sig, r_int, sweep(sigmas), seed, sweep(ls)))
+    write_option(fout, "repeat", N_REPEAT)